@@ -22,15 +22,22 @@
 #include <string.h>
 #include "Charmonizer/Probe.h"
 #include "Charmonizer/Probe/AtomicOps.h"
+#include "Charmonizer/Probe/Attributes.h"
+#include "Charmonizer/Probe/CPUDispatch.h"
+#include "Charmonizer/Probe/CPUTopology.h"
 #include "Charmonizer/Probe/DirManip.h"
 #include "Charmonizer/Probe/Floats.h"
 #include "Charmonizer/Probe/FuncMacro.h"
 #include "Charmonizer/Probe/Headers.h"
 #include "Charmonizer/Probe/Booleans.h"
+#include "Charmonizer/Probe/Builtins.h"
 #include "Charmonizer/Probe/Integers.h"
 #include "Charmonizer/Probe/LargeFiles.h"
 #include "Charmonizer/Probe/Memory.h"
+#include "Charmonizer/Probe/SIMD.h"
 #include "Charmonizer/Probe/SymbolVisibility.h"
+#include "Charmonizer/Probe/ThreadLocal.h"
+#include "Charmonizer/Probe/Threads.h"
 #include "Charmonizer/Probe/UnusedVars.h"
 #include "Charmonizer/Probe/VariadicMacros.h"
 #include "Charmonizer/Core/HeaderChecker.h"
@@ -63,7 +70,14 @@ int main(int argc, const char **argv) {
     chaz_Floats_run();
     chaz_LargeFiles_run();
     chaz_Memory_run();
+    chaz_SIMD_run();
+    chaz_CPUDispatch_run();
+    chaz_CPUTopology_run();
+    chaz_Builtins_run();
+    chaz_Attributes_run();
     chaz_SymbolVisibility_run();
+    chaz_ThreadLocal_run();
+    chaz_Threads_run();
     chaz_UnusedVars_run();
     chaz_VariadicMacros_run();
 
@@ -117,11 +117,19 @@ sub test_block {
     my $obj = $self->objectify($c_test_case);
     my $test_obj
         = $self->pathify( $self->objectify("src/Charmonizer/Test.c") );
+    my @objects = ( $obj, $test_obj );
+    my $prereqs = "$test_obj $obj";
+
+    # TestMake exercises the core directly.
+    if ( $c_test_case =~ /TestMake\.c$/ ) {
+        push @objects, '$(CORE_OBJS)';
+        $prereqs .= ' $(CORE_OBJS)';
+    }
     my $link_command = $self->build_link_command(
-        objects => [ $obj, $test_obj ],
+        objects => \@objects,
         target  => '$@',
     );
-    return qq|$exe: $test_obj $obj\n\t$link_command|;
+    return qq|$exe: $prereqs\n\t$link_command|;
 }
 
 sub clean_rule { confess "abstract method" }
@@ -195,6 +203,8 @@ sub gen_makefile {
     );
     my $clean_rule  = $self->clean_rule;
     my $objs        = join " ", map { $self->objectify($_) } @$c_files;
+    my $core_objs   = join " ", map { $self->objectify($_) }
+        grep { $_ !~ /charmonize\.c$/ } @$c_files;
     my $test_objs   = join " ", map { $self->objectify($_) } @$c_tests;
     my $test_blocks = join "\n\n",
         map { $self->test_block($_) } @$c_test_cases;
@@ -236,6 +246,9 @@ TESTS= $test_execs
 
 OBJS= $objs
 
+# Objects linked into TestMake, which exercises the core directly.
+CORE_OBJS= $core_objs
+
 TEST_OBJS= $test_objs
 
 HEADERS= $headers
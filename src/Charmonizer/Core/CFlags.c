@@ -163,6 +163,194 @@ chaz_CFlags_enable_debugging(chaz_CFlags *flags) {
     }
 }
 
+void
+chaz_CFlags_split_debug_info(chaz_CFlags *flags) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        chaz_CFlags_append(flags, "-gsplit-dwarf");
+    }
+    else {
+        chaz_Util_die("Don't know how to split debug info with '%s'",
+                      chaz_CC_get_cc());
+    }
+}
+
+void
+chaz_CFlags_compress_debug_sections(chaz_CFlags *flags, const char *format) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        char *string = chaz_Util_join("", "-Wl,--compress-debug-sections=",
+                                      format, NULL);
+        chaz_CFlags_append(flags, string);
+        free(string);
+    }
+    else {
+        chaz_Util_die("Don't know how to compress debug sections with '%s'",
+                      chaz_CC_get_cc());
+    }
+}
+
+void
+chaz_CFlags_link_gdb_index(chaz_CFlags *flags) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        chaz_CFlags_append(flags, "-Wl,--gdb-index");
+    }
+    else {
+        chaz_Util_die("Don't know how to create a GDB index with '%s'",
+                      chaz_CC_get_cc());
+    }
+}
+
+void
+chaz_CFlags_enable_time_trace(chaz_CFlags *flags) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        /* Clang writes a JSON trace next to the object file, GCC prints a
+         * report. */
+        chaz_CFlags_append(flags, chaz_CC_is_clang()
+                                  ? "-ftime-trace"
+                                  : "-ftime-report");
+    }
+    else {
+        chaz_Util_die("Don't know how to profile compilation with '%s'",
+                      chaz_CC_get_cc());
+    }
+}
+
+void
+chaz_CFlags_use_linker(chaz_CFlags *flags, const char *linker) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        char *string = chaz_Util_join("", "-fuse-ld=", linker, NULL);
+        chaz_CFlags_append(flags, string);
+        free(string);
+    }
+    else {
+        chaz_Util_die("Don't know how to select a linker with '%s'",
+                      chaz_CC_get_cc());
+    }
+}
+
+void
+chaz_CFlags_enable_lto(chaz_CFlags *flags) {
+    const char *string;
+    if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        string = "/GL";
+    }
+    else if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        /* Run LTRANS jobs in parallel with the jobserver or the number of
+         * CPUs. "-flto=auto" was added in GCC 10.
+         */
+        if (chaz_CC_is_gcc()
+            && !chaz_CC_is_clang()
+            && chaz_CC_test_gcc_version(">= 100000")
+           ) {
+            string = "-flto=auto";
+        }
+        else {
+            string = "-flto";
+        }
+    }
+    else if (flags->style == CHAZ_CFLAGS_STYLE_SUN_C) {
+        string = "-xipo=2";
+    }
+    else {
+        chaz_Util_die("Don't know how to enable LTO with '%s'",
+                      chaz_CC_get_cc());
+        return;
+    }
+    chaz_CFlags_append(flags, string);
+}
+
+void
+chaz_CFlags_enable_thin_lto(chaz_CFlags *flags) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_GNU && chaz_CC_is_clang()) {
+        chaz_CFlags_append(flags, "-flto=thin");
+    }
+    else {
+        chaz_CFlags_enable_lto(flags);
+    }
+}
+
+void
+chaz_CFlags_link_lto(chaz_CFlags *flags) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        chaz_CFlags_append(flags, "/LTCG");
+    }
+    else {
+        chaz_CFlags_enable_lto(flags);
+    }
+}
+
+void
+chaz_CFlags_link_thin_lto(chaz_CFlags *flags) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        chaz_CFlags_append(flags, "/LTCG");
+    }
+    else {
+        chaz_CFlags_enable_thin_lto(flags);
+    }
+}
+
+void
+chaz_CFlags_enable_profile_generate(chaz_CFlags *flags) {
+    const char *string;
+    if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        /* PGO requires whole program optimization. */
+        string = "/GL";
+    }
+    else if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        string = chaz_CC_is_clang()
+                 ? "-fprofile-instr-generate"
+                 : "-fprofile-generate";
+    }
+    else {
+        chaz_Util_die("Don't know how to enable profiling with '%s'",
+                      chaz_CC_get_cc());
+        return;
+    }
+    chaz_CFlags_append(flags, string);
+}
+
+void
+chaz_CFlags_link_profile_generate(chaz_CFlags *flags) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        chaz_CFlags_append(flags, "/LTCG /GENPROFILE");
+    }
+    else {
+        chaz_CFlags_enable_profile_generate(flags);
+    }
+}
+
+void
+chaz_CFlags_enable_profile_use(chaz_CFlags *flags, const char *profile) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        chaz_CFlags_append(flags, "/GL");
+    }
+    else if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        if (chaz_CC_is_clang()) {
+            char *string = chaz_Util_join("", "-fprofile-instr-use=", profile,
+                                          NULL);
+            chaz_CFlags_append(flags, string);
+            free(string);
+        }
+        else {
+            /* GCC reads the .gcda files next to the object files. */
+            chaz_CFlags_append(flags, "-fprofile-use");
+        }
+    }
+    else {
+        chaz_Util_die("Don't know how to use profiles with '%s'",
+                      chaz_CC_get_cc());
+    }
+}
+
+void
+chaz_CFlags_link_profile_use(chaz_CFlags *flags, const char *profile) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        chaz_CFlags_append(flags, "/LTCG /USEPROFILE");
+    }
+    else {
+        chaz_CFlags_enable_profile_use(flags, profile);
+    }
+}
+
 void
 chaz_CFlags_disable_strict_aliasing(chaz_CFlags *flags) {
     if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
@@ -396,4 +584,58 @@ chaz_CFlags_enable_code_coverage(chaz_CFlags *flags) {
     }
 }
 
+void
+chaz_CFlags_generate_dep_files(chaz_CFlags *flags) {
+    /* Write a makefile fragment with header dependencies next to each
+     * object file. -MP adds phony targets for headers so that removed
+     * headers don't break the build. */
+    if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        chaz_CFlags_append(flags, "-MMD -MP");
+    }
+    else if (flags->style == CHAZ_CFLAGS_STYLE_SUN_C) {
+        chaz_CFlags_append(flags, "-xMMD");
+    }
+}
+
+void
+chaz_CFlags_create_pch(chaz_CFlags *flags, const char *header,
+                       const char *pch) {
+    char *string;
+
+    if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        chaz_CFlags_append(flags, "-x c-header");
+    }
+    else if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        /* The header is force-included into a stub source file. The
+         * current directory is added to the include path since MSVC
+         * doesn't search it by default. */
+        string = chaz_Util_join("", "/I. /FI\"", header, "\" /Yc\"", header,
+                                "\" /Fp\"", pch, "\"", NULL);
+        chaz_CFlags_append(flags, string);
+        free(string);
+    }
+}
+
+void
+chaz_CFlags_use_pch(chaz_CFlags *flags, const char *header, const char *pch) {
+    char *string;
+
+    if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        if (chaz_CC_is_clang()) {
+            string = chaz_Util_join(" ", "-include-pch", pch, NULL);
+        }
+        else {
+            /* GCC picks up header.gch automatically. */
+            string = chaz_Util_join(" ", "-include", header, NULL);
+        }
+        chaz_CFlags_append(flags, string);
+        free(string);
+    }
+    else if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        string = chaz_Util_join("", "/I. /FI\"", header, "\" /Yu\"", header,
+                                "\" /Fp\"", pch, "\"", NULL);
+        chaz_CFlags_append(flags, string);
+        free(string);
+    }
+}
 
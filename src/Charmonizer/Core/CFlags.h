@@ -62,6 +62,48 @@ chaz_CFlags_add_include_dir(chaz_CFlags *flags, const char *dir);
 void
 chaz_CFlags_enable_optimization(chaz_CFlags *flags);
 
+void
+chaz_CFlags_enable_debugging(chaz_CFlags *flags);
+
+void
+chaz_CFlags_split_debug_info(chaz_CFlags *flags);
+
+void
+chaz_CFlags_compress_debug_sections(chaz_CFlags *flags, const char *format);
+
+void
+chaz_CFlags_link_gdb_index(chaz_CFlags *flags);
+
+void
+chaz_CFlags_enable_time_trace(chaz_CFlags *flags);
+
+void
+chaz_CFlags_use_linker(chaz_CFlags *flags, const char *linker);
+
+void
+chaz_CFlags_enable_lto(chaz_CFlags *flags);
+
+void
+chaz_CFlags_enable_thin_lto(chaz_CFlags *flags);
+
+void
+chaz_CFlags_link_lto(chaz_CFlags *flags);
+
+void
+chaz_CFlags_link_thin_lto(chaz_CFlags *flags);
+
+void
+chaz_CFlags_enable_profile_generate(chaz_CFlags *flags);
+
+void
+chaz_CFlags_link_profile_generate(chaz_CFlags *flags);
+
+void
+chaz_CFlags_enable_profile_use(chaz_CFlags *flags, const char *profile);
+
+void
+chaz_CFlags_link_profile_use(chaz_CFlags *flags, const char *profile);
+
 void
 chaz_CFlags_disable_strict_aliasing(chaz_CFlags *flags);
 
@@ -98,6 +140,16 @@ chaz_CFlags_add_rpath(chaz_CFlags *flags, const char *path);
 void
 chaz_CFlags_enable_code_coverage(chaz_CFlags *flags);
 
+void
+chaz_CFlags_generate_dep_files(chaz_CFlags *flags);
+
+void
+chaz_CFlags_create_pch(chaz_CFlags *flags, const char *header,
+                       const char *pch);
+
+void
+chaz_CFlags_use_pch(chaz_CFlags *flags, const char *header, const char *pch);
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,24 @@ chaz_CC_build_lib_filename(const char *dir, const char *prefix,
                            const char *basename, const char *version,
                            const char *ext);
 
+/* Try to archive and link an object compiled with link-time optimization
+ * using the given archiver.
+ */
+static int
+chaz_CC_try_lto(int mode, const char *archiver);
+
+/* Check whether the archiver supports response files and thin archives.
+ * The probe is only run once for every archiver.
+ */
+static void
+chaz_CC_probe_archiver(void);
+
+/* Run an archiver command creating `lib_file` and check whether a test
+ * program can be linked against the library.
+ */
+static int
+chaz_CC_try_archive(const char *command, const char *lib_file);
+
 /* Temporary files. */
 #define CHAZ_CC_TRY_SOURCE_PATH  "_charmonizer_try.c"
 #define CHAZ_CC_TRY_BASENAME     "_charmonizer_try"
@@ -63,12 +81,21 @@ static struct {
     int       is_sun_c;
     int       is_cygwin;
     int       is_mingw;
+    int       lto_mode;
+    char     *linker;
+    const char *archiver;
+    const char *ranlib;
+    int       archiver_probed;
+    int       archiver_rsp;
+    int       archiver_thin;
     chaz_CFlags *extra_cflags;
     chaz_CFlags *temp_cflags;
 } chaz_CC = {
     NULL, NULL, NULL,
     "", "", "", "", "", "",
-    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0,
+    NULL, "ar", "ranlib",
+    0, 0, 0,
     NULL, NULL
 };
 
@@ -295,6 +322,7 @@ chaz_CC_clean_up(void) {
     free(chaz_CC.cc_command);
     free(chaz_CC.cflags);
     free(chaz_CC.try_exe_name);
+    free(chaz_CC.linker);
     chaz_CFlags_destroy(chaz_CC.extra_cflags);
     chaz_CFlags_destroy(chaz_CC.temp_cflags);
 }
@@ -525,6 +553,11 @@ chaz_CC_is_gcc(void) {
     return chaz_CC.is_gcc;
 }
 
+int
+chaz_CC_is_clang(void) {
+    return chaz_CC.is_clang;
+}
+
 int
 chaz_CC_is_msvc(void) {
     return chaz_CC.is_msvc;
@@ -575,17 +608,135 @@ chaz_CC_link_command() {
 char*
 chaz_CC_format_archiver_command(const char *target, const char *objects) {
     if (chaz_CC_is_msvc()) {
-        /* TODO: Write `objects` to a temporary file in order to avoid
-         * exceeding line length limits. */
+        /* `objects` may name a response file to avoid exceeding line
+         * length limits. */
+        const char *ltcg = chaz_CC.lto_mode ? "/LTCG" : NULL;
         char *out = chaz_Util_join("", "/OUT:", target, NULL);
-        char *command = chaz_Util_join(" ", "lib", "/NOLOGO", objects, out,
-                                       NULL);
+        char *command = ltcg
+                        ? chaz_Util_join(" ", "lib", "/NOLOGO", ltcg, objects,
+                                         out, NULL)
+                        : chaz_Util_join(" ", "lib", "/NOLOGO", objects, out,
+                                         NULL);
         free(out);
         return command;
     }
     else {
-        return chaz_Util_join(" ", "ar", "rcs", target, objects, NULL);
+        return chaz_Util_join(" ", chaz_CC.archiver, "rcs", target, objects,
+                              NULL);
+    }
+}
+
+char*
+chaz_CC_format_thin_archiver_command(const char *target,
+                                     const char *objects) {
+    if (!chaz_CC_archiver_supports_thin()) {
+        chaz_Util_die("Archiver '%s' doesn't support thin archives",
+                      chaz_CC_is_msvc() ? "lib" : chaz_CC.archiver);
+    }
+    return chaz_Util_join(" ", chaz_CC.archiver, "rcsT", target, objects,
+                          NULL);
+}
+
+int
+chaz_CC_archiver_supports_rsp(void) {
+    chaz_CC_probe_archiver();
+    return chaz_CC.archiver_rsp;
+}
+
+int
+chaz_CC_archiver_supports_thin(void) {
+    chaz_CC_probe_archiver();
+    return chaz_CC.archiver_thin;
+}
+
+static void
+chaz_CC_probe_archiver(void) {
+    static const char lib_code[] =
+        "int chaz_CC_ar_func(int i) { return i + 1; }\n";
+    const char *obj_dir = "_charm_ar_dir";
+    char *obj_name;
+    char *obj_file;
+    char *lib_file;
+    char *rsp_content;
+    char *command;
+    char *p;
+
+    if (chaz_CC.archiver_probed) { return; }
+    chaz_CC.archiver_probed = 1;
+
+    if (chaz_CC_is_msvc()) {
+        /* lib.exe always reads @file arguments, but has no thin archives. */
+        chaz_CC.archiver_rsp  = 1;
+        chaz_CC.archiver_thin = 0;
+        return;
+    }
+
+    /* Put the object in a directory to check that the archiver reads
+     * paths from response files as written by the Make module.
+     */
+    chaz_OS_mkdir(obj_dir);
+    obj_name = chaz_Util_join(chaz_OS_dir_sep(), obj_dir, "_charm_ar", NULL);
+    obj_file = chaz_Util_join("", obj_name, chaz_CC.obj_ext, NULL);
+    lib_file = chaz_Util_join("", "_charm_ar_lib", chaz_CC.static_lib_ext,
+                              NULL);
+
+    if (chaz_CC_compile_obj("_charm_ar.c", obj_name, lib_code)) {
+        /* GNU and LLVM ar read arguments from @file. Backslashes are
+         * escape characters in response files, so the Make module writes
+         * paths with forward slashes.
+         */
+        rsp_content = chaz_Util_join("", obj_file, "\n", NULL);
+        for (p = rsp_content; *p != '\0'; p++) {
+            if (*p == '\\') { *p = '/'; }
+        }
+        chaz_Util_write_file("_charm_ar.rsp", rsp_content);
+        command = chaz_CC_format_archiver_command(lib_file,
+                                                  "@_charm_ar.rsp");
+        chaz_CC.archiver_rsp = chaz_CC_try_archive(command, lib_file);
+        free(command);
+        free(rsp_content);
+        chaz_Util_remove_and_verify("_charm_ar.rsp");
+
+        /* Thin archives only store the paths of the objects. */
+        command = chaz_Util_join(" ", chaz_CC.archiver, "rcsT", lib_file,
+                                 obj_file, NULL);
+        chaz_CC.archiver_thin = chaz_CC_try_archive(command, lib_file);
+        free(command);
+
+        chaz_Util_remove_and_verify(obj_file);
+    }
+    chaz_OS_rmdir(obj_dir);
+
+    if (chaz_Util_verbosity) {
+        printf("Archiver '%s' %s response files, %s thin archives\n",
+               chaz_CC.archiver,
+               chaz_CC.archiver_rsp ? "supports" : "doesn't support",
+               chaz_CC.archiver_thin ? "supports" : "doesn't support");
+    }
+
+    free(lib_file);
+    free(obj_file);
+    free(obj_name);
+}
+
+static int
+chaz_CC_try_archive(const char *command, const char *lib_file) {
+    static const char main_code[] =
+        "int chaz_CC_ar_func(int i);\n"
+        "int main(void) { return chaz_CC_ar_func(-1); }\n";
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    int succeeded = 0;
+
+    chaz_OS_run_quietly(command);
+
+    if (chaz_Util_can_open_file(lib_file)) {
+        chaz_CFlags_append(temp_cflags, lib_file);
+        succeeded = chaz_CC_test_link(main_code);
+        chaz_CFlags_clear(temp_cflags);
+        chaz_Util_remove_and_verify(lib_file);
     }
+
+    return succeeded;
 }
 
 char*
@@ -593,7 +744,173 @@ chaz_CC_format_ranlib_command(const char *target) {
     if (chaz_CC_is_msvc()) {
         return NULL;
     }
-    return chaz_Util_join(" ", "ranlib", target, NULL);
+    return chaz_Util_join(" ", chaz_CC.ranlib, target, NULL);
+}
+
+const char*
+chaz_CC_select_linker(const char *linker) {
+    /* In order of preference. */
+    static const char *const linkers[] = { "mold", "lld", "gold", NULL };
+    static const char code[] = "int main(void) { return 0; }\n";
+    chaz_CFlags *temp_cflags;
+    int i;
+
+    free(chaz_CC.linker);
+    chaz_CC.linker = NULL;
+
+    if (linker != NULL && strcmp(linker, "default") == 0) { return NULL; }
+    if (linker != NULL && strcmp(linker, "fast") == 0) { linker = NULL; }
+    /* Only compiler drivers with GNU flags support -fuse-ld. */
+    if (chaz_CC.cflags_style != CHAZ_CFLAGS_STYLE_GNU) {
+        if (linker != NULL) {
+            chaz_Util_warn("Can't select linker '%s' with '%s'", linker,
+                           chaz_CC.cc_command);
+        }
+        return NULL;
+    }
+
+    temp_cflags = chaz_CC_get_temp_cflags();
+    for (i = 0; linkers[i] != NULL; i++) {
+        const char *candidate = linker ? linker : linkers[i];
+
+        chaz_CFlags_use_linker(temp_cflags, candidate);
+        if (chaz_CC_test_link(code)) {
+            chaz_CC.linker = chaz_Util_strdup(candidate);
+        }
+        chaz_CFlags_clear(temp_cflags);
+
+        if (chaz_CC.linker || linker) { break; }
+    }
+
+    if (chaz_CC.linker) {
+        if (chaz_Util_verbosity) {
+            printf("Using linker '%s'\n", chaz_CC.linker);
+        }
+    }
+    else if (linker) {
+        chaz_Util_warn("Linker '%s' doesn't work, using the default linker",
+                       linker);
+    }
+
+    return chaz_CC.linker;
+}
+
+const char*
+chaz_CC_get_linker(void) {
+    return chaz_CC.linker;
+}
+
+int
+chaz_CC_enable_lto(int mode) {
+    /* Archivers need a plugin to create a symbol index for LTO objects.
+     * The wrappers shipped with the compilers load the right plugin.
+     */
+    static const char *const gcc_tools[]   = {
+        "gcc-ar", "gcc-ranlib", "ar", "ranlib", NULL
+    };
+    static const char *const clang_tools[] = {
+        "llvm-ar", "llvm-ranlib", "ar", "ranlib", NULL
+    };
+    static const char *const other_tools[] = { "ar", "ranlib", NULL };
+    const char *const *tools;
+    int i;
+
+    if (mode == CHAZ_CC_LTO_NONE
+        || chaz_CC.cflags_style == CHAZ_CFLAGS_STYLE_POSIX
+       ) {
+        return chaz_CC.lto_mode = CHAZ_CC_LTO_NONE;
+    }
+    /* ThinLTO is only supported by Clang. */
+    if (mode == CHAZ_CC_LTO_THIN && !chaz_CC_is_clang()) {
+        mode = CHAZ_CC_LTO_FULL;
+    }
+
+    if (chaz_CC_is_clang()) {
+        tools = clang_tools;
+    }
+    else if (chaz_CC_is_gcc()) {
+        tools = gcc_tools;
+    }
+    else {
+        tools = other_tools;
+    }
+
+    for (; mode != CHAZ_CC_LTO_NONE; mode--) {
+        for (i = 0; tools[i] != NULL; i += 2) {
+            if (chaz_CC_try_lto(mode, tools[i])) {
+                chaz_CC.lto_mode = mode;
+                chaz_CC.archiver = tools[i];
+                chaz_CC.ranlib   = tools[i+1];
+                chaz_CC.archiver_probed = 0;
+                if (chaz_Util_verbosity) {
+                    printf("Link-time optimization enabled (%s, %s)\n",
+                           mode == CHAZ_CC_LTO_THIN ? "thin" : "full",
+                           tools[i]);
+                }
+                return mode;
+            }
+        }
+    }
+
+    if (chaz_Util_verbosity) {
+        printf("Link-time optimization not supported\n");
+    }
+    return chaz_CC.lto_mode = CHAZ_CC_LTO_NONE;
+}
+
+static int
+chaz_CC_try_lto(int mode, const char *archiver) {
+    static const char lib_code[] =
+        "int chaz_CC_lto_func(int i) { return i + 1; }\n";
+    static const char main_code[] =
+        "int chaz_CC_lto_func(int i);\n"
+        "int main(void) { return chaz_CC_lto_func(-1); }\n";
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    char *obj_file = chaz_Util_join("", "_charm_lto", chaz_CC.obj_ext, NULL);
+    char *lib_file = chaz_Util_join("", "_charm_lto_lib",
+                                    chaz_CC.static_lib_ext, NULL);
+    char *command;
+    int saved_lto_mode = chaz_CC.lto_mode;
+    const char *saved_archiver = chaz_CC.archiver;
+    int succeeded = 0;
+
+    if (mode == CHAZ_CC_LTO_THIN) {
+        chaz_CFlags_enable_thin_lto(temp_cflags);
+    }
+    else {
+        chaz_CFlags_enable_lto(temp_cflags);
+    }
+    if (chaz_CC.linker) {
+        chaz_CFlags_use_linker(temp_cflags, chaz_CC.linker);
+    }
+
+    if (chaz_CC_compile_obj("_charm_lto.c", "_charm_lto", lib_code)) {
+        chaz_CC.lto_mode = mode;
+        chaz_CC.archiver = archiver;
+        command = chaz_CC_format_archiver_command(lib_file, obj_file);
+        chaz_CC.lto_mode = saved_lto_mode;
+        chaz_CC.archiver = saved_archiver;
+        chaz_OS_run_quietly(command);
+        free(command);
+
+        if (chaz_Util_can_open_file(lib_file)) {
+            /* The compiler driver passes the LTO flags on to the linker. */
+            chaz_CFlags_append(temp_cflags, lib_file);
+            succeeded = chaz_CC_test_link(main_code);
+        }
+    }
+
+    chaz_CFlags_clear(temp_cflags);
+    chaz_Util_remove_and_verify(obj_file);
+    chaz_Util_remove_and_verify(lib_file);
+    free(lib_file);
+    free(obj_file);
+    return succeeded;
+}
+
+int
+chaz_CC_lto_mode(void) {
+    return chaz_CC.lto_mode;
 }
 
 char*
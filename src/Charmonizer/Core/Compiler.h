@@ -32,6 +32,10 @@ extern "C" {
 #define CHAZ_CC_BINFMT_MACHO    2
 #define CHAZ_CC_BINFMT_PE       3
 
+#define CHAZ_CC_LTO_NONE        0
+#define CHAZ_CC_LTO_FULL        1
+#define CHAZ_CC_LTO_THIN        2
+
 /* Attempt to compile and link an executable.  Return true if the executable
  * file exists after the attempt.
  */
@@ -145,6 +149,9 @@ chaz_CC_obj_ext(void);
 int
 chaz_CC_is_gcc(void);
 
+int
+chaz_CC_is_clang(void);
+
 int
 chaz_CC_is_msvc(void);
 
@@ -172,11 +179,33 @@ chaz_CC_link_command(void);
 /* Create a command for building a static library.
  *
  * @param target The target library filename.
- * @param objects The list of object files to be archived in the library.
+ * @param objects The list of object files to be archived in the library,
+ * or a response file in the form `@file` if the archiver supports it.
  */
 char*
 chaz_CC_format_archiver_command(const char *target, const char *objects);
 
+/* Create a command for building a thin static library which only stores
+ * the paths of the object files. Thin libraries can't be installed.
+ * Dies if the archiver doesn't support thin archives.
+ *
+ * @param target The target library filename.
+ * @param objects The list of object files or a response file.
+ */
+char*
+chaz_CC_format_thin_archiver_command(const char *target,
+                                     const char *objects);
+
+/* Return true if the archiver reads arguments from `@file` response files.
+ */
+int
+chaz_CC_archiver_supports_rsp(void);
+
+/* Return true if the archiver can create thin archives.
+ */
+int
+chaz_CC_archiver_supports_thin(void);
+
 /* Returns a "ranlib" command if valid.
  *
  * @param target The library filename.
@@ -184,6 +213,42 @@ chaz_CC_format_archiver_command(const char *target, const char *objects);
 char*
 chaz_CC_format_ranlib_command(const char *target);
 
+/* Select a linker for the compiler driver. With "fast" or NULL, the first
+ * linker out of mold, lld and gold that can link a test program is
+ * selected.
+ *
+ * @param linker The linker to use, "default" for the default linker of the
+ * compiler driver, or "fast" or NULL to select the fastest available
+ * linker.
+ * @return The name of the selected linker or NULL if the default linker is
+ * used.
+ */
+const char*
+chaz_CC_select_linker(const char *linker);
+
+/* Return the linker selected with chaz_CC_select_linker or NULL.
+ */
+const char*
+chaz_CC_get_linker(void);
+
+/* Enable link-time optimization if objects compiled with LTO can be
+ * archived and linked with the detected toolchain. On success, archiver
+ * and ranlib commands use tools which understand LTO objects. Falls back
+ * to full LTO if ThinLTO doesn't work and to no LTO if full LTO doesn't
+ * work.
+ *
+ * @param mode One of CHAZ_CC_LTO_NONE, CHAZ_CC_LTO_FULL or
+ * CHAZ_CC_LTO_THIN.
+ * @return The LTO mode that was enabled.
+ */
+int
+chaz_CC_enable_lto(int mode);
+
+/* Return the LTO mode enabled with chaz_CC_enable_lto.
+ */
+int
+chaz_CC_lto_mode(void);
+
 /** Returns the filename for a shared library.
  *
  * @param dir The target directory or NULL for the current directory.
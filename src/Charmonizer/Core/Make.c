@@ -28,49 +28,86 @@
 #define CHAZ_MAKEBINARY_STATIC_LIB  2
 #define CHAZ_MAKEBINARY_SHARED_LIB  3
 
+/* A growable, NULL-terminated list of strings. Capacity is doubled on
+ * demand so that appending is amortized constant time even for huge
+ * source trees.
+ */
+typedef struct {
+    char   **items;
+    size_t   num_items;
+    size_t   cap;
+} chaz_MakeStrList;
+
 struct chaz_MakeVar {
-    char   *name;
-    char   *value;
-    size_t  num_elements;
+    char             *name;
+    chaz_MakeStrList  elements;
 };
 
 struct chaz_MakeRule {
-    char *targets;
-    char *prereqs;
-    char *commands;
+    chaz_MakeStrList targets;
+    chaz_MakeStrList prereqs;
+    chaz_MakeStrList commands;
+    int              grouped;  /* One recipe run creates all targets. */
 };
 
 struct chaz_MakeBinary {
-    chaz_MakeRule  *rule;  /* Owned by MakeBinary. */
-
-    chaz_MakeVar   *obj_var;
-    char           *obj_dollar_var;
-    char          **sources;  /* List of all sources. */
-    size_t          num_sources;
-    char          **single_sources;  /* Only sources from add_src_file. */
-    size_t          num_single_sources;
-    char          **dirs;
-    size_t          num_dirs;
-
-    chaz_MakeVar   *cflags_var;
-    chaz_CFlags    *cflags;
-
-    chaz_MakeVar   *ldflags_var;
-    chaz_CFlags    *ldflags;
+    int               type;
+    chaz_MakeRule    *rule;  /* Owned by MakeBinary. */
+
+    chaz_MakeVar     *obj_var;
+    char             *obj_dollar_var;
+    chaz_MakeStrList  sources;  /* List of all sources. */
+    chaz_MakeStrList  single_sources;  /* Only sources from add_src_file. */
+    chaz_MakeStrList  dirs;
+
+    chaz_MakeVar     *cflags_var;
+    chaz_CFlags      *cflags;
+
+    chaz_MakeVar     *ldflags_var;
+    chaz_CFlags      *ldflags;
+
+    chaz_MakeFile    *makefile;  /* Not owned. */
+
+    /* Precompiled header. */
+    chaz_MakeRule    *pch_rule;
+    char             *pch_cflags;    /* Flags to use the PCH. */
+    char             *pch_dep_file;  /* NULL without dependency tracking. */
+
+    const char       *obj_prefix;  /* Prefix of object paths or NULL. */
+
+    /* Unity build. */
+    size_t                   unity_batch_size;  /* 0 if disabled. */
+    chaz_Make_file_filter_t  unity_filter;
+    void                    *unity_filter_ctx;
+    chaz_MakeStrList         unity_files;
+    chaz_MakeStrList        *unity_batches;  /* Sources of each unity file. */
+
+    int                      thin_archive;
+    int                      fast_load;
+    int                      split_debug_info;
 };
 
 struct chaz_MakeFile {
-    chaz_MakeVar    **vars;
-    size_t            num_vars;
-    chaz_MakeRule   **rules;
-    size_t            num_rules;
-    char            **install_dirs;
-    size_t            num_install_dirs;
-    chaz_MakeRule    *install;
-    chaz_MakeRule    *clean;
-    chaz_MakeRule    *distclean;
-    chaz_MakeBinary **binaries;
-    size_t            num_binaries;
+    chaz_MakeVar     **vars;
+    size_t             num_vars;
+    size_t             vars_cap;
+    chaz_MakeRule    **rules;
+    size_t             num_rules;
+    size_t             rules_cap;
+    chaz_MakeStrList   install_dirs;
+    chaz_MakeRule     *install;
+    chaz_MakeRule     *clean;
+    chaz_MakeRule     *distclean;
+    chaz_MakeBinary  **binaries;
+    size_t             num_binaries;
+    size_t             binaries_cap;
+    chaz_MakeFile     *parent;  /* NULL for the top-level makefile. */
+    char              *dir;     /* Directory of a fragment. */
+    chaz_MakeFile    **fragments;
+    size_t             num_fragments;
+    size_t             fragments_cap;
+    char              *pgo_target;  /* NULL if PGO is disabled. */
+    int                finalized;   /* Generated rules were added. */
 };
 
 typedef struct {
@@ -79,17 +116,65 @@ typedef struct {
     void                    *filter_ctx;
 } chaz_MakeBinaryContext;
 
+/* State for translating strings in make syntax to Ninja syntax. */
+typedef struct {
+    chaz_MakeFile *makefile;
+    const char    *target;      /* Replacement for $@ or NULL. */
+    const char    *source;      /* Replacement for $< or NULL. */
+    int            is_path;     /* Escape spaces and colons. */
+    int            is_command;  /* Unescape percent signs for cmd.exe. */
+    FILE          *out;
+} chaz_MakeNinjaContext;
+
+/* An object file together with the binary it is compiled for. */
+typedef struct {
+    char             *obj;
+    const char       *source;
+    chaz_MakeStrList *batch;  /* Sources included by a unity file or NULL. */
+    chaz_MakeBinary  *binary;
+    size_t            seq;
+} chaz_MakeNinjaObj;
+
 /* Static vars. */
 static struct {
     chaz_CLI *cli;
     char     *make_command;
     int       shell_type;
     int       supports_pattern_rules;
+    int       supports_include;
+    int       supports_nmake_include;
+    int       supports_grouped_targets;
+    int       dep_files;
+    int       show_includes;  /* Dependencies from MSVC's /showIncludes. */
+    int       ninja;
+    int       pch_probed;
+    int       supports_pch;
+    int       pgo_probed;
+    int       supports_pgo;
+    const char *profdata;  /* Command to merge Clang profiles. */
+    char     *compiler_cache;
+    int       fast_load_probed;
+    chaz_CFlags *fast_load_cflags;
+    chaz_CFlags *fast_load_ldflags;
+    chaz_CFlags *fast_load_shared_ldflags;
+    int       debug_info_probed;
+    int       split_dwarf;
+    const char *compress_debug;  /* Compression format or NULL. */
+    int       gdb_index;
+    int       build_profiling;
+    int       time_trace_json;  /* Compiler writes JSON traces. */
 } chaz_Make = {
     NULL, NULL,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    NULL, NULL,
+    0, NULL, NULL, NULL,
+    0, 0, NULL, 0,
     0, 0
 };
 
+/* Directory for the objects and profiles of the instrumented build. */
+#define CHAZ_MAKE_PGO_DIR "pgo-gen"
+
 /* Detect make command.
  *
  * The argument list must be a NULL-terminated series of different spellings
@@ -107,6 +192,137 @@ S_chaz_Make_detect(const char *make1, ...);
 static int
 S_chaz_Make_audition(const char *make);
 
+/* Check whether the compiler can write header dependencies to makefile
+ * fragments which the make utility is able to include. With MSVC and
+ * nmake, the fragments are created from the /showIncludes output.
+ */
+static void
+S_chaz_Make_probe_dep_files(void);
+
+/* Check whether the compiler supports precompiled headers. The probe is
+ * only run once.
+ */
+static int
+S_chaz_Make_probe_pch(void);
+
+/* Return the path of the precompiled header for a header file.
+ *
+ * @param tag A name which makes the path unique for a binary or NULL.
+ */
+static char*
+S_chaz_Make_pch_path(const char *header, const char *tag);
+
+/* Replace the extension of a path.
+ */
+static char*
+S_chaz_Make_replace_ext(const char *path, const char *ext);
+
+/* Check whether the compiler supports instrumented builds, merging and
+ * using profiles.
+ */
+static int
+S_chaz_Make_probe_pgo(void);
+
+/* Find the flags of the fast load profile supported by the compiler and
+ * linker. The probe is only run once.
+ */
+static void
+S_chaz_Make_probe_fast_load(void);
+
+/* Check which flags for split and compressed debug info are supported.
+ * The probe is only run once.
+ */
+static void
+S_chaz_Make_probe_debug_info(void);
+
+/* Check whether a test program links with the given flags and the
+ * selected linker.
+ */
+static int
+S_chaz_Make_test_link_flags(const char *flags);
+
+/* Append the flags that link a test program successfully.
+ *
+ * @param candidates A NULL-terminated array of flags.
+ */
+static void
+S_chaz_Make_append_working_flags(chaz_CFlags *flags,
+                                 const char *const *candidates);
+
+/* Check whether the compiler can report where compilation time is spent.
+ */
+static void
+S_chaz_Make_probe_build_profiling(void);
+
+/* Find a compiler cache like ccache or sccache which is able to compile
+ * a test file.
+ */
+static void
+S_chaz_Make_probe_compiler_cache(void);
+
+/* Return the value of the CC variable, the compiler command possibly
+ * wrapped by a compiler cache.
+ */
+static char*
+S_chaz_Make_cc_value(void);
+
+/* Return a command creating a precompiled header.
+ *
+ * @param cc The compiler command.
+ * @param cflags The compiler flags.
+ * @param stub A stub source file if the compiler needs one, otherwise NULL.
+ * @param stub_obj The object file created from the stub.
+ */
+static char*
+S_chaz_Make_pch_command(const char *cc, const char *cflags,
+                        const char *header, const char *pch,
+                        const char *stub, const char *stub_obj);
+
+/* Return the start of a command compiling a C source file.
+ */
+static const char*
+S_chaz_Make_cc_command(void);
+
+/* Make sure that a NULL-terminated array of pointers has room for one more
+ * element plus the terminating NULL. Returns the possibly reallocated array.
+ */
+static void*
+S_chaz_Make_grow_array(void *array, size_t num_elems, size_t *cap);
+
+static void
+S_chaz_MakeStrList_push(chaz_MakeStrList *self, const char *string);
+
+/* Push every whitespace-separated word of a string.
+ */
+static void
+S_chaz_MakeStrList_push_words(chaz_MakeStrList *self, const char *string);
+
+/* Return the items of the list concatenated with a separator.
+ */
+static char*
+S_chaz_MakeStrList_join(chaz_MakeStrList *self, const char *sep);
+
+static void
+S_chaz_MakeStrList_destroy(chaz_MakeStrList *self);
+
+/* Remove all items contained in another list which must be sorted.
+ */
+static void
+S_chaz_MakeStrList_remove(chaz_MakeStrList *self, chaz_MakeStrList *sorted);
+
+static int
+S_chaz_MakeStrList_compare(const void *va, const void *vb);
+
+/* Allocate a MakeFile without install, clean and distclean rules.
+ */
+static chaz_MakeFile*
+S_chaz_MakeFile_alloc(void);
+
+/* Return the path of the file a fragment is written to.
+ */
+static char*
+S_chaz_MakeFile_fragment_path(chaz_MakeFile *self);
+
 static chaz_MakeBinary*
 S_chaz_MakeFile_add_binary(chaz_MakeFile *self, int type, const char *basename,
                            const char *target);
@@ -114,18 +330,131 @@ S_chaz_MakeFile_add_binary(chaz_MakeFile *self, int type, const char *basename,
 static void
 S_chaz_MakeFile_add_install_dir(chaz_MakeFile *self, const char *dir);
 
+/* Write the variables holding the installation directories, either in make
+ * or in Ninja syntax.
+ */
+static void
+S_chaz_MakeFile_write_install_vars(chaz_MakeFile *self, FILE *out,
+                                   int ninja);
+
+/* Return a new copy of the install rule with commands to create the
+ * installation directories prepended.
+ */
+static chaz_MakeRule*
+S_chaz_MakeFile_full_install_rule(chaz_MakeFile *self);
+
+/* Return a new copy of the distclean rule which also removes the files
+ * written by Ninja. These can't be removed from within build.ninja.
+ */
+static chaz_MakeRule*
+S_chaz_MakeFile_full_distclean_rule(chaz_MakeFile *self);
+
+/* Write a file named 'build.ninja' with the same targets as the Makefile.
+ */
+static void
+S_chaz_MakeFile_write_ninja(chaz_MakeFile *self);
+
+static chaz_MakeVar*
+S_chaz_MakeFile_find_var(chaz_MakeFile *self, const char *name);
+
+/* Return the top-level makefile for index 0 and its fragments for the
+ * following indices. Returns NULL after the last fragment.
+ */
+static chaz_MakeFile*
+S_chaz_MakeFile_tree_item(chaz_MakeFile *self, size_t i);
+
+/* Append the compiler and linker flags of all binaries to their make
+ * variables.
+ */
+static void
+S_chaz_MakeFile_finalize_binaries(chaz_MakeFile *self);
+
+static void
+S_chaz_MakeFile_write_vars(chaz_MakeFile *self, FILE *out);
+
+/* Write the user rules and the rules of binaries.
+ */
+static void
+S_chaz_MakeFile_write_rules(chaz_MakeFile *self, FILE *out);
+
+/* Write a fragment to its own file and include it from the top-level
+ * makefile. If the make utility doesn't support includes, the fragment is
+ * written inline.
+ */
+static void
+S_chaz_MakeFile_write_fragment(chaz_MakeFile *self, FILE *top);
+
+/* Include the dependency files of all objects.
+ */
+static void
+S_chaz_MakeFile_write_dep_includes(chaz_MakeFile *self, FILE *out);
+
+/* Include the dependency files created from the /showIncludes output of
+ * MSVC. nmake can't skip missing files, so every include is conditional.
+ */
+static void
+S_chaz_MakeFile_write_nmake_dep_includes(chaz_MakeFile *self, FILE *out);
+
+/* Add the rules of the PGO workflow. Called when the makefile is written,
+ * after all binaries were added.
+ */
+static void
+S_chaz_MakeFile_add_pgo_rules(chaz_MakeFile *self);
+
+/* Add a rule summarizing the time traces of all objects. Called when the
+ * makefile is written, after all binaries were added.
+ */
+static void
+S_chaz_MakeFile_add_build_profile_rule(chaz_MakeFile *self);
+
+/* Apply the flags of all binaries and add the generated rules. Only runs
+ * once, so that the makefile can be written multiple times.
+ */
 static void
-S_chaz_MakeFile_write_install_vars(FILE *out);
+S_chaz_MakeFile_finalize(chaz_MakeFile *self);
+
+/* Return a recursive make command building the PGO target with the given
+ * compiler and linker flags.
+ */
+static char*
+S_chaz_MakeFile_pgo_make_command(chaz_MakeFile *self, const char *dir,
+                                 chaz_CFlags *cflags, chaz_CFlags *ldflags);
 
 static void
 S_chaz_MakeFile_write_binary_rules(chaz_MakeBinary *binary, FILE *out);
 
+/* Write a rule for each unity file of a binary. The objects depend on all
+ * the sources included by the unity file.
+ *
+ * @param cflags Additional compiler flags.
+ * @param prereq An additional prerequisite or NULL.
+ */
+static void
+S_chaz_MakeFile_write_unity_rules(chaz_MakeBinary *binary, const char *cflags,
+                                  const char *prereq, FILE *out);
+
+/* Write a rule for each object file.
+ *
+ * @param obj_prefix A prefix for the object paths or NULL.
+ * @param cflags Additional compiler flags.
+ * @param prereq An additional prerequisite or NULL.
+ */
 static void
-S_chaz_MakeFile_write_object_rules(char **sources, const char *command,
+S_chaz_MakeFile_write_object_rules(chaz_MakeStrList *sources,
+                                   const char *obj_prefix,
+                                   const char *cflags, const char *prereq,
                                    FILE *out);
 
+/* Write a pattern rule for each directory.
+ *
+ * @param obj_prefix A prefix for the object paths or NULL.
+ * @param cflags Additional compiler flags.
+ * @param prereq An additional prerequisite or NULL.
+ */
 static void
-S_chaz_MakeFile_write_pattern_rules(char **dirs, const char *command,
+S_chaz_MakeFile_write_pattern_rules(chaz_MakeStrList *dirs,
+                                    const char *obj_prefix,
+                                    const char *cflags, const char *prereq,
                                     FILE *out);
 
 static chaz_MakeRule*
@@ -137,6 +466,66 @@ S_chaz_MakeRule_destroy(chaz_MakeRule *self);
 static void
 S_chaz_MakeRule_write(chaz_MakeRule *self, FILE *out);
 
+/* Add a command compiling a C file to the object file `$@`. If header
+ * dependencies are taken from the /showIncludes output of MSVC, it's
+ * converted to a makefile fragment next to the object file.
+ */
+static void
+S_chaz_MakeRule_add_compile_command(chaz_MakeRule *self, const char *command);
+
+/* Write a rule with grouped targets for make utilities that don't support
+ * them. The recipe creates a stamp file which the targets depend on.
+ */
+static void
+S_chaz_MakeRule_write_stamped(chaz_MakeRule *self, FILE *out);
+
+/* Return the path of the stamp file for a rule with grouped targets.
+ */
+static char*
+S_chaz_MakeRule_stamp_path(chaz_MakeRule *self);
+
+static void
+S_chaz_MakeVar_write(chaz_MakeVar *self, FILE *out);
+
+/* Write a string in make syntax with variable references converted to
+ * Ninja syntax. Substitution references are expanded in place.
+ */
+static void
+S_chaz_MakeNinja_write_string(chaz_MakeNinjaContext *ctx, const char *string);
+
+static void
+S_chaz_MakeNinja_write_ref(chaz_MakeNinjaContext *ctx, const char *ref,
+                           size_t len);
+
+/* Write a whitespace-separated list of paths to a Ninja build line. Variable
+ * references spanning a whole path are expanded, so that every element of
+ * the variable becomes a separate path.
+ */
+static void
+S_chaz_MakeNinja_write_paths(chaz_MakeNinjaContext *ctx, const char *paths,
+                             int depth);
+
+static void
+S_chaz_MakeNinja_write_var(chaz_MakeNinjaContext *ctx, const char *name,
+                           chaz_MakeStrList *elements);
+
+/* Write a make rule as a Ninja build statement.
+ */
+static void
+S_chaz_MakeNinja_write_rule(chaz_MakeNinjaContext *ctx, chaz_MakeRule *rule,
+                            const char *pool);
+
+/* Write a rule whose targets aren't files, like 'install' or 'clean'. The
+ * commands run in a build statement with a private output that is never
+ * created and the targets are phony aliases for it.
+ */
+static void
+S_chaz_MakeNinja_write_command_rule(chaz_MakeNinjaContext *ctx,
+                                    chaz_MakeRule *rule);
+
+static int
+S_chaz_MakeNinja_compare_objs(const void *va, const void *vb);
+
 static void
 S_chaz_MakeBinary_destroy(chaz_MakeBinary *self);
 
@@ -153,12 +542,47 @@ S_chaz_MakeBinary_do_add_src_file(chaz_MakeBinary *self, const char *path);
 static char*
 S_chaz_MakeBinary_obj_path(const char *src_path);
 
+/* Return a lowercase name for the binary derived from the name of its
+ * object variable.
+ */
+static char*
+S_chaz_MakeBinary_tag(chaz_MakeBinary *self);
+
+/* Write the unity files of the binary and replace the objects of the
+ * included sources with the objects of the unity files.
+ */
+static void
+S_chaz_MakeBinary_finalize_unity(chaz_MakeBinary *self);
+
+/* Add the flags for split and compressed debug info.
+ */
+static void
+S_chaz_MakeBinary_apply_split_debug_info(chaz_MakeBinary *self);
+
+/* Put the flags of the fast load profile in front of the flags of the
+ * binary.
+ */
+static void
+S_chaz_MakeBinary_apply_fast_load(chaz_MakeBinary *self);
+
+/* Add the command archiving the objects of a static library. If the
+ * archiver supports it, the objects are passed in a response file.
+ */
+static void
+S_chaz_MakeBinary_add_archiver_command(chaz_MakeBinary *self);
+
+/* Prepend a prefix to the objects compiled from the sources of the binary.
+ */
+static void
+S_chaz_MakeBinary_prefix_objs(chaz_MakeBinary *self, const char *prefix);
+
 void
 chaz_Make_init(chaz_CLI *cli) {
     const char *make_command = chaz_CLI_strval(cli, "make");
 
     chaz_Make.cli        = cli;
     chaz_Make.shell_type = chaz_OS_shell_type();
+    chaz_Make.ninja      = chaz_CLI_defined(cli, "enable-ninja");
 
     if (make_command) {
         if (!S_chaz_Make_detect(make_command, NULL)) {
@@ -188,11 +612,42 @@ chaz_Make_init(chaz_CLI *cli) {
             printf("Detected make utility '%s'\n", chaz_Make.make_command);
         }
     }
+
+    S_chaz_Make_probe_dep_files();
+
+    if (chaz_CLI_defined(cli, "enable-build-profiling")) {
+        S_chaz_Make_probe_build_profiling();
+    }
+
+    if (chaz_CLI_defined(cli, "enable-compiler-cache")) {
+        S_chaz_Make_probe_compiler_cache();
+    }
+
+    /* The linker must be known before probing LTO which might depend on
+     * linker plugins. Without the option, the compiler driver's default
+     * linker is used.
+     */
+    if (chaz_CLI_defined(cli, "linker")) {
+        chaz_CC_select_linker(chaz_CLI_strval(cli, "linker"));
+    }
+
+    if (chaz_CLI_defined(cli, "enable-thin-lto")) {
+        chaz_CC_enable_lto(CHAZ_CC_LTO_THIN);
+    }
+    else if (chaz_CLI_defined(cli, "enable-lto")) {
+        chaz_CC_enable_lto(CHAZ_CC_LTO_FULL);
+    }
 }
 
 void
 chaz_Make_clean_up(void) {
     free(chaz_Make.make_command);
+    free(chaz_Make.compiler_cache);
+    if (chaz_Make.fast_load_probed) {
+        chaz_CFlags_destroy(chaz_Make.fast_load_cflags);
+        chaz_CFlags_destroy(chaz_Make.fast_load_ldflags);
+        chaz_CFlags_destroy(chaz_Make.fast_load_shared_ldflags);
+    }
 }
 
 const char*
@@ -267,88 +722,808 @@ S_chaz_Make_audition(const char *make) {
         }
         chaz_Util_remove_and_verify("_charm_foo");
         free(command);
+
+        /* Check whether missing makefiles can be included silently. */
+        chaz_Util_write_file("_charm_Makefile_inc",
+                             "-include _charm_nonexistent.d\n"
+                             "\n"
+                             "foo:\n"
+                             "\t@echo 5b7a9d1e2c3f4086\n");
+        command = chaz_Util_join(" ", make, "-f", "_charm_Makefile_inc",
+                                 NULL);
+        chaz_OS_run_redirected(command, "_charm_foo");
+        if (chaz_Util_can_open_file("_charm_foo")) {
+            size_t len;
+            char *content = chaz_Util_slurp_file("_charm_foo", &len);
+            if (content != NULL
+                && strstr(content, "5b7a9d1e2c3f4086") != NULL
+               ) {
+                chaz_Make.supports_include = 1;
+            }
+            free(content);
+        }
+        chaz_Util_remove_and_verify("_charm_foo");
+        chaz_Util_remove_and_verify("_charm_Makefile_inc");
+        free(command);
+
+        /* Check for the conditional includes of nmake. */
+        if (!chaz_Make.supports_include
+            && chaz_Make.shell_type == CHAZ_OS_CMD_EXE
+           ) {
+            chaz_Util_write_file("_charm_Makefile_inc",
+                                 "!IF EXIST(_charm_nonexistent.d)\n"
+                                 "!INCLUDE _charm_nonexistent.d\n"
+                                 "!ENDIF\n"
+                                 "\n"
+                                 "foo:\n"
+                                 "\t@echo 2d6f8b1a4c3e5097\n");
+            command = chaz_Util_join(" ", make, "-f", "_charm_Makefile_inc",
+                                     NULL);
+            chaz_OS_run_redirected(command, "_charm_foo");
+            if (chaz_Util_can_open_file("_charm_foo")) {
+                size_t len;
+                char *content = chaz_Util_slurp_file("_charm_foo", &len);
+                if (content != NULL
+                    && strstr(content, "2d6f8b1a4c3e5097") != NULL
+                   ) {
+                    chaz_Make.supports_nmake_include = 1;
+                }
+                free(content);
+            }
+            chaz_Util_remove_and_verify("_charm_foo");
+            chaz_Util_remove_and_verify("_charm_Makefile_inc");
+            free(command);
+        }
+
+        /* Check for grouped targets. Other make utilities fail to parse
+         * the rule or run the recipe once for every target.
+         */
+        chaz_Util_write_file("_charm_Makefile_grp",
+                             "_charm_ga _charm_gb &:\n"
+                             "\t@echo 9e3c5a7b1d2f4068\n");
+        command = chaz_Util_join(" ", make, "-f", "_charm_Makefile_grp",
+                                 "_charm_ga _charm_gb", NULL);
+        chaz_OS_run_redirected(command, "_charm_foo");
+        if (chaz_Util_can_open_file("_charm_foo")) {
+            size_t len;
+            char *content = chaz_Util_slurp_file("_charm_foo", &len);
+            char *first = content
+                          ? strstr(content, "9e3c5a7b1d2f4068")
+                          : NULL;
+            if (first != NULL
+                && strstr(first + 1, "9e3c5a7b1d2f4068") == NULL
+               ) {
+                chaz_Make.supports_grouped_targets = 1;
+            }
+            free(content);
+        }
+        chaz_Util_remove_and_verify("_charm_foo");
+        chaz_Util_remove_and_verify("_charm_Makefile_grp");
+        free(command);
     }
 
     return succeeded;
 }
 
-chaz_MakeFile*
-chaz_MakeFile_new() {
-    chaz_MakeFile *self = (chaz_MakeFile*)calloc(1, sizeof(chaz_MakeFile));
-    char *generated;
-
-    self->vars         = (chaz_MakeVar**)calloc(1, sizeof(chaz_MakeVar*));
-    self->rules        = (chaz_MakeRule**)calloc(1, sizeof(chaz_MakeRule*));
-    self->install_dirs = (char**)calloc(1, sizeof(char*));
+static void
+S_chaz_Make_probe_dep_files(void) {
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    const char *code = "#include <stddef.h>\nint i;\n";
+    const char *dep_file = "_charmonizer_try.d";
+
+    if (chaz_CC_is_msvc() && chaz_Make.supports_nmake_include) {
+        chaz_Make.show_includes = 1;
+        if (chaz_Util_verbosity) {
+            printf("Generated makefiles will track header dependencies\n");
+        }
+        return;
+    }
+    if (!chaz_Make.supports_include) { return; }
 
-    self->install   = S_chaz_MakeRule_new("install", "all");
-    self->clean     = S_chaz_MakeRule_new("clean", NULL);
-    self->distclean = S_chaz_MakeRule_new("distclean", "clean");
+    chaz_CFlags_generate_dep_files(temp_cflags);
+    if (chaz_CFlags_get_string(temp_cflags)[0] != '\0') {
+        chaz_Util_remove_and_verify(dep_file);
+        if (chaz_CC_test_compile(code)
+            && chaz_Util_can_open_file(dep_file)
+           ) {
+            chaz_Make.dep_files = 1;
+        }
+        chaz_Util_remove_and_verify(dep_file);
+    }
+    chaz_CFlags_clear(temp_cflags);
 
-    self->binaries = (chaz_MakeBinary**)calloc(1, sizeof(chaz_MakeBinary*));
+    if (chaz_Make.dep_files && chaz_Util_verbosity) {
+        printf("Generated makefiles will track header dependencies\n");
+    }
+}
 
-    /* MSVC leaves .obj files around when creating executables. */
-    generated = chaz_Util_join("", "charmonizer", chaz_OS_exe_ext(),
-                               " charmonizer.obj charmony.h Makefile", NULL);
-    chaz_MakeRule_add_rm_command(self->distclean, generated);
+static int
+S_chaz_Make_probe_pch(void) {
+    static const char header_code[] = "#define CHAZ_PCH_VALUE 42\n";
+    static const char code[] =
+        "#if CHAZ_PCH_VALUE != 42\n"
+        "#error Precompiled header not used\n"
+        "#endif\n"
+        "int i;\n";
+    const char *header = "_charm_pch.h";
+    chaz_CFlags *extra_cflags = chaz_CC_get_extra_cflags();
+    chaz_CFlags *temp_cflags  = chaz_CC_get_temp_cflags();
+    char *pch;
+    char *stub     = NULL;
+    char *stub_obj = NULL;
+    char *cflags;
+    char *command;
 
-    free(generated);
-    return self;
-}
+    if (chaz_Make.pch_probed) { return chaz_Make.supports_pch; }
+    chaz_Make.pch_probed = 1;
 
-void
-chaz_MakeFile_destroy(chaz_MakeFile *self) {
-    size_t i;
+    /* Unsupported compilers don't add any flags. */
+    chaz_CFlags_use_pch(temp_cflags, header, "_charm_pch");
+    if (chaz_CFlags_get_string(temp_cflags)[0] == '\0') { return 0; }
+    chaz_CFlags_clear(temp_cflags);
 
-    for (i = 0; self->vars[i]; i++) {
-        chaz_MakeVar *var = self->vars[i];
-        free(var->name);
-        free(var->value);
-        free(var);
+    pch = S_chaz_Make_pch_path(header, NULL);
+    if (chaz_CC_is_msvc()) {
+        stub     = S_chaz_Make_replace_ext(pch, ".c");
+        stub_obj = S_chaz_Make_replace_ext(pch, chaz_CC_obj_ext());
+        chaz_Util_write_file(stub, "");
     }
-    free(self->vars);
+    cflags = chaz_Util_join(" ", chaz_CC_get_cflags(),
+                            extra_cflags
+                            ? chaz_CFlags_get_string(extra_cflags) : "",
+                            NULL);
+    command = S_chaz_Make_pch_command(chaz_CC_get_cc(), cflags, header, pch,
+                                      stub, stub_obj);
+
+    /* Create the PCH and compile a file using it. */
+    chaz_Util_write_file(header, header_code);
+    if (chaz_Util_verbosity < 2) {
+        chaz_OS_run_quietly(command);
+    }
+    else {
+        printf("%s\n", command);
+        system(command);
+    }
+    if (chaz_Util_can_open_file(stub_obj ? stub_obj : pch)) {
+        chaz_CFlags_use_pch(temp_cflags, header, pch);
+        chaz_Make.supports_pch = chaz_CC_test_compile(code);
+        chaz_CFlags_clear(temp_cflags);
+    }
+
+    chaz_Util_remove_and_verify(header);
+    chaz_Util_remove_and_verify(pch);
+    if (stub) {
+        chaz_Util_remove_and_verify(stub);
+        chaz_Util_remove_and_verify(stub_obj);
+    }
+
+    if (chaz_Make.supports_pch && chaz_Util_verbosity) {
+        printf("Compiler supports precompiled headers\n");
+    }
+
+    free(command);
+    free(cflags);
+    free(stub_obj);
+    free(stub);
+    free(pch);
+    return chaz_Make.supports_pch;
+}
+
+static void
+S_chaz_Make_probe_fast_load(void) {
+    /* Section splitting lets --gc-sections drop unused code and data.
+     * Without semantic interposition, calls within a library can be
+     * inlined and bypass the PLT.
+     */
+    static const char *const elf_cflags[] = {
+        "-ffunction-sections -fdata-sections",
+        "-fno-semantic-interposition",
+        NULL
+    };
+    /* -O1 optimizes the hash table and --hash-style=gnu makes symbol
+     * lookup faster. --as-needed drops unused library dependencies.
+     */
+    static const char *const elf_ldflags[] = {
+        "-Wl,-O1",
+        "-Wl,--hash-style=gnu",
+        "-Wl,--as-needed",
+        "-Wl,--gc-sections",
+        NULL
+    };
+    /* Bind calls to functions within a shared library at link time.
+     * Only functions are bound, so variables can still be interposed.
+     */
+    static const char *const elf_shared_ldflags[] = {
+        "-Wl,-Bsymbolic-functions",
+        NULL
+    };
+    static const char *const macho_ldflags[] = { "-Wl,-dead_strip", NULL };
+
+    if (chaz_Make.fast_load_probed) { return; }
+    chaz_Make.fast_load_probed = 1;
+
+    chaz_Make.fast_load_cflags         = chaz_CC_new_cflags();
+    chaz_Make.fast_load_ldflags        = chaz_CC_new_cflags();
+    chaz_Make.fast_load_shared_ldflags = chaz_CC_new_cflags();
+
+    if (chaz_CC_is_msvc()) {
+        /* Function-level linking, removal of unreferenced functions and
+         * data and identical COMDAT folding.
+         */
+        chaz_CFlags_append(chaz_Make.fast_load_cflags, "/Gy");
+        chaz_CFlags_append(chaz_Make.fast_load_ldflags,
+                           "/OPT:REF /OPT:ICF");
+    }
+    else if (chaz_CC_is_gcc()) {
+        /* Don't try ELF linker flags with other linkers. ld64, for
+         * example, would take -dead_strip for -d -e ad_strip.
+         */
+        if (chaz_CC_binary_format() == CHAZ_CC_BINFMT_ELF) {
+            S_chaz_Make_append_working_flags(chaz_Make.fast_load_cflags,
+                                             elf_cflags);
+            S_chaz_Make_append_working_flags(chaz_Make.fast_load_ldflags,
+                                             elf_ldflags);
+            S_chaz_Make_append_working_flags(
+                chaz_Make.fast_load_shared_ldflags, elf_shared_ldflags);
+        }
+        else if (chaz_CC_binary_format() == CHAZ_CC_BINFMT_MACHO) {
+            S_chaz_Make_append_working_flags(chaz_Make.fast_load_ldflags,
+                                             macho_ldflags);
+        }
+    }
+
+    if (chaz_Util_verbosity) {
+        printf("Fast load flags: %s %s %s\n",
+               chaz_CFlags_get_string(chaz_Make.fast_load_cflags),
+               chaz_CFlags_get_string(chaz_Make.fast_load_ldflags),
+               chaz_CFlags_get_string(chaz_Make.fast_load_shared_ldflags));
+    }
+}
+
+static void
+S_chaz_Make_append_working_flags(chaz_CFlags *flags,
+                                 const char *const *candidates) {
+    int i;
+
+    for (i = 0; candidates[i] != NULL; i++) {
+        if (S_chaz_Make_test_link_flags(candidates[i])) {
+            chaz_CFlags_append(flags, candidates[i]);
+        }
+    }
+}
+
+static int
+S_chaz_Make_test_link_flags(const char *flags) {
+    static const char code[] = "int main(void) { return 0; }\n";
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    int result;
+
+    /* Linker options depend on the linker selected with -fuse-ld. */
+    if (chaz_CC_get_linker()) {
+        chaz_CFlags_use_linker(temp_cflags, chaz_CC_get_linker());
+    }
+    chaz_CFlags_append(temp_cflags, flags);
+    result = chaz_CC_test_link(code);
+    chaz_CFlags_clear(temp_cflags);
+
+    return result;
+}
+
+static void
+S_chaz_Make_probe_debug_info(void) {
+    static const char *const formats[] = { "zstd", "zlib", NULL };
+    static const char code[] = "int main(void) { return 0; }\n";
+    chaz_CFlags *temp_cflags;
+    int i;
+
+    if (chaz_Make.debug_info_probed) { return; }
+    chaz_Make.debug_info_probed = 1;
+
+    /* Only GNU-style toolchains support these flags. MSVC always writes
+     * debug info to separate PDB files.
+     */
+    if (!chaz_CC_is_gcc()) { return; }
+
+    temp_cflags = chaz_CC_get_temp_cflags();
+    chaz_CFlags_enable_debugging(temp_cflags);
+    chaz_CFlags_split_debug_info(temp_cflags);
+    if (chaz_CC_test_compile(code)) {
+        /* Some platforms accept the flag without writing .dwo files. */
+        chaz_Make.split_dwarf
+            = chaz_Util_can_open_file("_charmonizer_try.dwo");
+        chaz_Util_remove_and_verify("_charmonizer_try.dwo");
+    }
+    chaz_CFlags_clear(temp_cflags);
+
+    for (i = 0; formats[i] != NULL; i++) {
+        char *flags = chaz_Util_join("", "-g -Wl,--compress-debug-sections=",
+                                     formats[i], NULL);
+        int result = S_chaz_Make_test_link_flags(flags);
+        free(flags);
+        if (result) {
+            chaz_Make.compress_debug = formats[i];
+            break;
+        }
+    }
+
+    chaz_Make.gdb_index = S_chaz_Make_test_link_flags("-g -Wl,--gdb-index");
+
+    if (chaz_Util_verbosity) {
+        printf("Split debug info: %s, compression: %s, GDB index: %s\n",
+               chaz_Make.split_dwarf ? "yes" : "no",
+               chaz_Make.compress_debug ? chaz_Make.compress_debug : "none",
+               chaz_Make.gdb_index ? "yes" : "no");
+    }
+}
+
+static void
+S_chaz_Make_probe_build_profiling(void) {
+    static const char code[] = "int foo(void) { return 0; }\n";
+    chaz_CFlags *temp_cflags;
+
+    if (!chaz_CC_is_gcc()) {
+        chaz_Util_warn("Build profiling not supported with '%s'",
+                       chaz_CC_get_cc());
+        return;
+    }
+
+    temp_cflags = chaz_CC_get_temp_cflags();
+    chaz_CFlags_enable_time_trace(temp_cflags);
+    chaz_Make.build_profiling = chaz_CC_test_compile(code);
+    chaz_CFlags_clear(temp_cflags);
+
+    if (!chaz_Make.build_profiling) {
+        chaz_Util_warn("Compiler doesn't support build profiling");
+        return;
+    }
+
+    chaz_Make.time_trace_json
+        = chaz_Util_can_open_file("_charmonizer_try.json");
+    chaz_Util_remove_and_verify("_charmonizer_try.json");
+
+    if (chaz_Util_verbosity) {
+        printf("Build profiling enabled (%s)\n",
+               chaz_Make.time_trace_json ? "JSON traces" : "time reports");
+    }
+}
+
+static void
+S_chaz_Make_probe_compiler_cache(void) {
+    static const char *const caches[] = { "ccache", "sccache", NULL };
+    static const char code[] = "int foo(void) { return 0; }\n";
+    const char *source = "_charm_cache.c";
+    char *obj = chaz_Util_join("", "_charm_cache", chaz_CC_obj_ext(), NULL);
+    chaz_CFlags *cflags = chaz_CC_new_cflags();
+    int i;
+
+    chaz_CFlags_set_output_obj(cflags, obj);
+    chaz_Util_write_file(source, code);
+
+    for (i = 0; caches[i] != NULL; i++) {
+        char *command
+            = chaz_Util_join(" ", caches[i], chaz_CC_get_cc(), source,
+                             chaz_CFlags_get_string(cflags), NULL);
+
+        chaz_OS_run_quietly(command);
+        free(command);
+
+        if (chaz_Util_can_open_file(obj)) {
+            chaz_Util_remove_and_verify(obj);
+            chaz_Make.compiler_cache = chaz_Util_strdup(caches[i]);
+            break;
+        }
+    }
+
+    chaz_Util_remove_and_verify(source);
+
+    if (chaz_Make.compiler_cache) {
+        if (chaz_Util_verbosity) {
+            printf("Using compiler cache '%s'\n", chaz_Make.compiler_cache);
+        }
+    }
+    else {
+        chaz_Util_warn("No working compiler cache found");
+    }
+
+    chaz_CFlags_destroy(cflags);
+    free(obj);
+}
+
+static char*
+S_chaz_Make_cc_value(void) {
+    /* Only compiler invocations are cached. LINK is never wrapped. */
+    if (chaz_Make.compiler_cache) {
+        return chaz_Util_join(" ", chaz_Make.compiler_cache,
+                              chaz_CC_get_cc(), NULL);
+    }
+    return chaz_Util_strdup(chaz_CC_get_cc());
+}
+
+static int
+S_chaz_Make_probe_pgo(void) {
+    static const char code[] = "int main(void) { return 0; }\n";
+    /* A profile in the text format of Clang's frontend instrumentation.
+     * The function hash doesn't match which only results in a warning.
+     */
+    static const char proftext[] = "main\n0\n1\n1\n";
+    static const char *const profdata_commands[] = {
+        "llvm-profdata", "xcrun llvm-profdata", NULL
+    };
+    chaz_CFlags *temp_cflags;
+    int i;
+
+    if (chaz_Make.pgo_probed) { return chaz_Make.supports_pgo; }
+    chaz_Make.pgo_probed = 1;
+
+    if (chaz_CC_is_msvc()) {
+        /* /GENPROFILE and /USEPROFILE were added in Visual Studio 2015. */
+        chaz_Make.supports_pgo = chaz_CC_test_msvc_version(">= 1900");
+    }
+    else if (chaz_CC_is_gcc()) {
+        temp_cflags = chaz_CC_get_temp_cflags();
+
+        /* Instrumented build. */
+        chaz_CFlags_link_profile_generate(temp_cflags);
+        if (!chaz_CC_test_link(code)) {
+            chaz_CFlags_clear(temp_cflags);
+            return 0;
+        }
+        chaz_CFlags_clear(temp_cflags);
+
+        if (chaz_CC_is_clang()) {
+            /* Merge a profile and compile with it. */
+            chaz_Util_write_file("_charm_pgo.proftext", proftext);
+            for (i = 0; profdata_commands[i] != NULL; i++) {
+                char *command
+                    = chaz_Util_join(" ", profdata_commands[i],
+                                     "merge -output=_charm_pgo.profdata",
+                                     "_charm_pgo.proftext", NULL);
+                chaz_OS_run_quietly(command);
+                free(command);
+
+                if (chaz_Util_can_open_file("_charm_pgo.profdata")) {
+                    chaz_CFlags_enable_profile_use(temp_cflags,
+                                                   "_charm_pgo.profdata");
+                    if (chaz_CC_test_compile(code)) {
+                        chaz_Make.profdata     = profdata_commands[i];
+                        chaz_Make.supports_pgo = 1;
+                    }
+                    chaz_CFlags_clear(temp_cflags);
+                    chaz_Util_remove_and_verify("_charm_pgo.profdata");
+                    break;
+                }
+            }
+            chaz_Util_remove_and_verify("_charm_pgo.proftext");
+        }
+        else {
+            /* GCC only warns about missing profiles. */
+            chaz_CFlags_enable_profile_use(temp_cflags, NULL);
+            chaz_Make.supports_pgo = chaz_CC_test_compile(code);
+            chaz_CFlags_clear(temp_cflags);
+        }
+    }
+
+    if (chaz_Make.supports_pgo && chaz_Util_verbosity) {
+        printf("Compiler supports profile-guided optimization\n");
+    }
+
+    return chaz_Make.supports_pgo;
+}
+
+static char*
+S_chaz_Make_pch_path(const char *header, const char *tag) {
+    if (chaz_CC_is_gcc() && !chaz_CC_is_clang()) {
+        /* GCC looks for 'header.gch' which can also be a directory
+         * containing precompiled headers for different flags.
+         */
+        if (tag == NULL) {
+            return chaz_Util_join("", header, ".gch", NULL);
+        }
+        return chaz_Util_join("", header, ".gch", chaz_OS_dir_sep(), tag,
+                              ".gch", NULL);
+    }
+
+    if (tag == NULL) {
+        return chaz_Util_join("", header, ".pch", NULL);
+    }
+    return chaz_Util_join(".", header, tag, "pch", NULL);
+}
+
+static char*
+S_chaz_Make_replace_ext(const char *path, const char *ext) {
+    const char *dot = strrchr(path, '.');
+    size_t len = dot ? (size_t)(dot - path) : strlen(path);
+    char *result = (char*)malloc(len + strlen(ext) + 1);
+
+    memcpy(result, path, len);
+    strcpy(result + len, ext);
+
+    return result;
+}
+
+static char*
+S_chaz_Make_pch_command(const char *cc, const char *cflags,
+                        const char *header, const char *pch,
+                        const char *stub, const char *stub_obj) {
+    chaz_CFlags *create_cflags = chaz_CC_new_cflags();
+    chaz_CFlags *output_cflags = chaz_CC_new_cflags();
+    char *command;
+
+    chaz_CFlags_create_pch(create_cflags, header, pch);
+    chaz_CFlags_set_output_obj(output_cflags, stub ? stub_obj : pch);
+    command = chaz_Util_join(" ", cc, cflags,
+                             chaz_CFlags_get_string(create_cflags),
+                             stub ? stub : header,
+                             chaz_CFlags_get_string(output_cflags), NULL);
+
+    chaz_CFlags_destroy(output_cflags);
+    chaz_CFlags_destroy(create_cflags);
+    return command;
+}
+
+static const char*
+S_chaz_Make_cc_command(void) {
+    if (chaz_CC_is_msvc()) {
+        return "$(CC) /nologo";
+    }
+    else if (chaz_Make.dep_files) {
+        return "$(CC) $(DEPFLAGS)";
+    }
+    else {
+        return "$(CC)";
+    }
+}
+
+static void*
+S_chaz_Make_grow_array(void *array, size_t num_elems, size_t *cap) {
+    if (array == NULL || num_elems + 2 > *cap) {
+        size_t new_cap = *cap < 8 ? 8 : *cap * 2;
+        while (new_cap < num_elems + 2) { new_cap *= 2; }
+        array = realloc(array, new_cap * sizeof(void*));
+        if (array == NULL) {
+            chaz_Util_die("Out of memory");
+        }
+        *cap = new_cap;
+    }
+    return array;
+}
+
+static void
+S_chaz_MakeStrList_push(chaz_MakeStrList *self, const char *string) {
+    size_t num_items = self->num_items;
+
+    self->items = (char**)S_chaz_Make_grow_array(self->items, num_items,
+                                                 &self->cap);
+    self->items[num_items]   = chaz_Util_strdup(string);
+    self->items[num_items+1] = NULL;
+    self->num_items = num_items + 1;
+}
+
+static void
+S_chaz_MakeStrList_push_words(chaz_MakeStrList *self, const char *string) {
+    static const char whitespace[] = " \t";
+    const char *p = string + strspn(string, whitespace);
+
+    while (*p != '\0') {
+        size_t len = strcspn(p, whitespace);
+        char *word = (char*)malloc(len + 1);
+
+        memcpy(word, p, len);
+        word[len] = '\0';
+        S_chaz_MakeStrList_push(self, word);
+        free(word);
+
+        p += len;
+        p += strspn(p, whitespace);
+    }
+}
+
+static char*
+S_chaz_MakeStrList_join(chaz_MakeStrList *self, const char *sep) {
+    size_t sep_len = strlen(sep);
+    size_t size    = 1;
+    size_t i;
+    char *retval;
+    char *p;
+
+    for (i = 0; i < self->num_items; i++) {
+        if (i != 0) { size += sep_len; }
+        size += strlen(self->items[i]);
+    }
+
+    retval = (char*)malloc(size);
+    p = retval;
+
+    for (i = 0; i < self->num_items; i++) {
+        size_t len = strlen(self->items[i]);
+        if (i != 0) {
+            memcpy(p, sep, sep_len);
+            p += sep_len;
+        }
+        memcpy(p, self->items[i], len);
+        p += len;
+    }
+
+    *p = '\0';
+    return retval;
+}
+
+static void
+S_chaz_MakeStrList_destroy(chaz_MakeStrList *self) {
+    size_t i;
+
+    for (i = 0; i < self->num_items; i++) {
+        free(self->items[i]);
+    }
+    free(self->items);
+
+    self->items     = NULL;
+    self->num_items = 0;
+    self->cap       = 0;
+}
+
+static void
+S_chaz_MakeStrList_remove(chaz_MakeStrList *self, chaz_MakeStrList *sorted) {
+    size_t num_kept = 0;
+    size_t i;
+
+    for (i = 0; i < self->num_items; i++) {
+        char *item = self->items[i];
+
+        if (bsearch(&item, sorted->items, sorted->num_items, sizeof(char*),
+                    S_chaz_MakeStrList_compare)) {
+            free(item);
+        }
+        else {
+            self->items[num_kept++] = item;
+        }
+    }
+
+    if (self->items) { self->items[num_kept] = NULL; }
+    self->num_items = num_kept;
+}
+
+static int
+S_chaz_MakeStrList_compare(const void *va, const void *vb) {
+    return strcmp(*(char *const *)va, *(char *const *)vb);
+}
+
+static chaz_MakeFile*
+S_chaz_MakeFile_alloc(void) {
+    chaz_MakeFile *self = (chaz_MakeFile*)calloc(1, sizeof(chaz_MakeFile));
+
+    self->vars = (chaz_MakeVar**)S_chaz_Make_grow_array(NULL, 0,
+                                                        &self->vars_cap);
+    self->vars[0] = NULL;
+    self->rules = (chaz_MakeRule**)S_chaz_Make_grow_array(NULL, 0,
+                                                          &self->rules_cap);
+    self->rules[0] = NULL;
+    self->binaries
+        = (chaz_MakeBinary**)S_chaz_Make_grow_array(NULL, 0,
+                                                    &self->binaries_cap);
+    self->binaries[0] = NULL;
+    self->fragments
+        = (chaz_MakeFile**)S_chaz_Make_grow_array(NULL, 0,
+                                                  &self->fragments_cap);
+    self->fragments[0] = NULL;
+
+    return self;
+}
+
+chaz_MakeFile*
+chaz_MakeFile_new() {
+    chaz_MakeFile *self = S_chaz_MakeFile_alloc();
+    char *generated;
+
+    self->install   = S_chaz_MakeRule_new("install", "all");
+    self->clean     = S_chaz_MakeRule_new("clean", NULL);
+    self->distclean = S_chaz_MakeRule_new("distclean", "clean");
+
+    /* MSVC leaves .obj files around when creating executables. */
+    generated = chaz_Util_join("", "charmonizer", chaz_OS_exe_ext(),
+                               " charmonizer.obj charmony.h Makefile", NULL);
+    chaz_MakeRule_add_rm_command(self->distclean, generated);
+
+    free(generated);
+    return self;
+}
+
+void
+chaz_MakeFile_destroy(chaz_MakeFile *self) {
+    size_t i;
+
+    for (i = 0; self->vars[i]; i++) {
+        chaz_MakeVar *var = self->vars[i];
+        free(var->name);
+        S_chaz_MakeStrList_destroy(&var->elements);
+        free(var);
+    }
+    free(self->vars);
 
     for (i = 0; self->rules[i]; i++) {
         S_chaz_MakeRule_destroy(self->rules[i]);
     }
     free(self->rules);
 
-    for (i = 0; self->install_dirs[i]; i++) {
-        free(self->install_dirs[i]);
-    }
-    free(self->install_dirs);
+    S_chaz_MakeStrList_destroy(&self->install_dirs);
 
     for (i = 0; self->binaries[i]; i++) {
         S_chaz_MakeBinary_destroy(self->binaries[i]);
     }
     free(self->binaries);
 
-    S_chaz_MakeRule_destroy(self->install);
-    S_chaz_MakeRule_destroy(self->clean);
-    S_chaz_MakeRule_destroy(self->distclean);
+    for (i = 0; self->fragments[i]; i++) {
+        chaz_MakeFile_destroy(self->fragments[i]);
+    }
+    free(self->fragments);
+
+    /* Fragments share the rules of the top-level makefile. */
+    if (self->parent == NULL) {
+        S_chaz_MakeRule_destroy(self->install);
+        S_chaz_MakeRule_destroy(self->clean);
+        S_chaz_MakeRule_destroy(self->distclean);
+    }
 
+    free(self->pgo_target);
+    free(self->dir);
     free(self);
 }
 
+chaz_MakeFile*
+chaz_MakeFile_add_fragment(chaz_MakeFile *self, const char *dir) {
+    chaz_MakeFile  *fragment;
+    chaz_MakeFile **fragments;
+    size_t          num_fragments = self->num_fragments;
+
+    if (self->parent) {
+        chaz_Util_die("Makefile fragments can't be nested");
+    }
+
+    fragment = S_chaz_MakeFile_alloc();
+    fragment->parent    = self;
+    fragment->dir       = chaz_Util_strdup(dir);
+    fragment->install   = self->install;
+    fragment->clean     = self->clean;
+    fragment->distclean = self->distclean;
+
+    fragments = (chaz_MakeFile**)S_chaz_Make_grow_array(
+                    self->fragments, num_fragments, &self->fragments_cap);
+    fragments[num_fragments]   = fragment;
+    fragments[num_fragments+1] = NULL;
+    self->fragments     = fragments;
+    self->num_fragments = num_fragments + 1;
+
+    if (chaz_Make.supports_include) {
+        char *path = S_chaz_MakeFile_fragment_path(fragment);
+        chaz_MakeRule_add_rm_command(self->distclean, path);
+        free(path);
+    }
+
+    return fragment;
+}
+
+static char*
+S_chaz_MakeFile_fragment_path(chaz_MakeFile *self) {
+    return chaz_Util_join(chaz_OS_dir_sep(), self->dir, "Makefile.inc", NULL);
+}
+
 chaz_MakeVar*
 chaz_MakeFile_add_var(chaz_MakeFile *self, const char *name,
                       const char *value) {
-    chaz_MakeVar  *var      = (chaz_MakeVar*)malloc(sizeof(chaz_MakeVar));
+    chaz_MakeVar  *var      = (chaz_MakeVar*)calloc(1, sizeof(chaz_MakeVar));
     chaz_MakeVar **vars     = self->vars;
-    size_t         num_vars = self->num_vars + 1;
+    size_t         num_vars = self->num_vars;
 
-    var->name         = chaz_Util_strdup(name);
-    var->value        = chaz_Util_strdup("");
-    var->num_elements = 0;
+    var->name = chaz_Util_strdup(name);
 
     if (value) { chaz_MakeVar_append(var, value); }
 
-    vars = (chaz_MakeVar**)realloc(vars,
-                                   (num_vars + 1) * sizeof(chaz_MakeVar*));
-    vars[num_vars-1] = var;
-    vars[num_vars]   = NULL;
+    vars = (chaz_MakeVar**)S_chaz_Make_grow_array(vars, num_vars,
+                                                  &self->vars_cap);
+    vars[num_vars]   = var;
+    vars[num_vars+1] = NULL;
     self->vars = vars;
-    self->num_vars = num_vars;
+    self->num_vars = num_vars + 1;
 
     return var;
 }
@@ -358,14 +1533,14 @@ chaz_MakeFile_add_rule(chaz_MakeFile *self, const char *target,
                        const char *prereq) {
     chaz_MakeRule  *rule      = S_chaz_MakeRule_new(target, prereq);
     chaz_MakeRule **rules     = self->rules;
-    size_t          num_rules = self->num_rules + 1;
+    size_t          num_rules = self->num_rules;
 
-    rules = (chaz_MakeRule**)realloc(rules,
-                                     (num_rules + 1) * sizeof(chaz_MakeRule*));
-    rules[num_rules-1] = rule;
-    rules[num_rules]   = NULL;
+    rules = (chaz_MakeRule**)S_chaz_Make_grow_array(rules, num_rules,
+                                                    &self->rules_cap);
+    rules[num_rules]   = rule;
+    rules[num_rules+1] = NULL;
     self->rules = rules;
-    self->num_rules = num_rules;
+    self->num_rules = num_rules + 1;
 
     return rule;
 }
@@ -557,19 +1732,18 @@ chaz_MakeBinary*
 chaz_MakeFile_add_static_lib(chaz_MakeFile *self, const char *dir,
                              const char *basename, int installed) {
     char *target = chaz_CC_static_lib_filename(dir, basename);
-    char *command;
     chaz_MakeBinary *binary
         = S_chaz_MakeFile_add_binary(self, CHAZ_MAKEBINARY_STATIC_LIB,
                                      basename, target);
 
-    command = chaz_CC_format_archiver_command("$@", binary->obj_dollar_var);
-    chaz_MakeRule_add_command(binary->rule, command);
+    /* The archiver command is added in S_chaz_MakeFile_finalize_binaries
+     * when the list of objects is complete.
+     */
 
     if (installed) {
         chaz_MakeFile_install(self, target, "$(LIBDIR)", NULL);
     }
 
-    free(command);
     free(target);
     return binary;
 }
@@ -588,7 +1762,6 @@ S_chaz_MakeFile_add_binary(chaz_MakeFile *self, int type, const char *basename,
     char *obj_dollar_var;
     size_t i;
     size_t num_binaries;
-    size_t alloc_size;
     chaz_MakeBinary **binaries;
 
     switch (type) {
@@ -612,24 +1785,60 @@ S_chaz_MakeFile_add_binary(chaz_MakeFile *self, int type, const char *basename,
 
     chaz_MakeFile_add_var(self, binary_var_name, target);
 
+    binary->type           = type;
     binary->rule           = S_chaz_MakeRule_new(target, obj_dollar_var);
     binary->obj_var        = chaz_MakeFile_add_var(self, obj_var_name, NULL);
     binary->obj_dollar_var = obj_dollar_var;
-    binary->sources        = (char**)calloc(1, sizeof(char*));
-    binary->single_sources = (char**)calloc(1, sizeof(char*));
-    binary->dirs           = (char**)calloc(1, sizeof(char*));
 
     binary->cflags_var  = chaz_MakeFile_add_var(self, cflags_var_name, NULL);
     binary->cflags      = chaz_CC_new_cflags();
     binary->ldflags_var = chaz_MakeFile_add_var(self, ldflags_var_name, NULL);
     binary->ldflags     = chaz_CC_new_cflags();
+    binary->makefile    = self;
+
+    if (chaz_CC_get_linker() && type != CHAZ_MAKEBINARY_STATIC_LIB) {
+        chaz_CFlags_use_linker(binary->ldflags, chaz_CC_get_linker());
+    }
+
+    /* Static libraries are archived with LTO-aware tools, see
+     * chaz_CC_format_archiver_command.
+     */
+    if (chaz_CC_lto_mode() == CHAZ_CC_LTO_THIN) {
+        chaz_CFlags_enable_thin_lto(binary->cflags);
+        if (type != CHAZ_MAKEBINARY_STATIC_LIB) {
+            chaz_CFlags_link_thin_lto(binary->ldflags);
+        }
+    }
+    else if (chaz_CC_lto_mode() == CHAZ_CC_LTO_FULL) {
+        chaz_CFlags_enable_lto(binary->cflags);
+        if (type != CHAZ_MAKEBINARY_STATIC_LIB) {
+            chaz_CFlags_link_lto(binary->ldflags);
+        }
+    }
 
     chaz_MakeRule_add_rm_command(self->clean, obj_dollar_var);
     chaz_MakeRule_add_rm_command(self->clean, target);
 
+    if (chaz_Make.dep_files || chaz_Make.show_includes) {
+        char *dep_files = chaz_Util_join("", "$(", obj_var_name, ":",
+                                         chaz_CC_obj_ext(), "=.d)", NULL);
+        chaz_MakeRule_add_rm_command(self->clean, dep_files);
+        free(dep_files);
+    }
+
+    if (chaz_Make.build_profiling) {
+        chaz_CFlags_enable_time_trace(binary->cflags);
+    }
+    if (chaz_Make.time_trace_json) {
+        char *traces = chaz_Util_join("", "$(", obj_var_name, ":",
+                                      chaz_CC_obj_ext(), "=.json)", NULL);
+        chaz_MakeRule_add_rm_command(self->clean, traces);
+        free(traces);
+    }
+
     num_binaries = self->num_binaries;
-    alloc_size   = (num_binaries + 2) * sizeof(chaz_MakeBinary*);
-    binaries     = (chaz_MakeBinary**)realloc(self->binaries, alloc_size);
+    binaries     = (chaz_MakeBinary**)S_chaz_Make_grow_array(
+                       self->binaries, num_binaries, &self->binaries_cap);
     binaries[num_binaries]   = binary;
     binaries[num_binaries+1] = NULL;
     self->binaries     = binaries;
@@ -661,6 +1870,9 @@ chaz_MakeFile_add_lemon_grammar(chaz_MakeFile *self,
     chaz_MakeRule *rule = chaz_MakeFile_add_rule(self, c_file, y_file);
     chaz_MakeRule *clean_rule = chaz_MakeFile_clean_rule(self);
 
+    /* Lemon creates both files in a single run. */
+    chaz_MakeRule_add_target(rule, h_file);
+    chaz_MakeRule_group_targets(rule);
     chaz_MakeRule_add_prereq(rule, "$(LEMON_EXE)");
     chaz_MakeRule_add_command(rule, command);
 
@@ -795,30 +2007,59 @@ chaz_MakeFile_install_pkgconfig(chaz_MakeFile *self, const char *name,
 
 static void
 S_chaz_MakeFile_add_install_dir(chaz_MakeFile *self, const char *dir) {
-    size_t   i;
-    size_t   num_install_dirs;
-    size_t   alloc_size;
-    char   **install_dirs;
+    size_t i;
 
-    for (i = 0; self->install_dirs[i]; i++) {
-        if (strcmp(dir, self->install_dirs[i]) == 0) {
+    /* Install dirs are created by the top-level makefile. */
+    while (self->parent) { self = self->parent; }
+
+    for (i = 0; i < self->install_dirs.num_items; i++) {
+        if (strcmp(dir, self->install_dirs.items[i]) == 0) {
             return;
         }
     }
 
-    num_install_dirs = self->num_install_dirs;
-    alloc_size       = (num_install_dirs + 2) * sizeof(char*);
-    install_dirs     = (char**)realloc(self->install_dirs, alloc_size);
-    install_dirs[num_install_dirs]   = chaz_Util_strdup(dir);
-    install_dirs[num_install_dirs+1] = NULL;
-    self->install_dirs     = install_dirs;
-    self->num_install_dirs = num_install_dirs + 1;
+    S_chaz_MakeStrList_push(&self->install_dirs, dir);
+}
+
+int
+chaz_MakeFile_enable_pgo(chaz_MakeFile *self, const char *target,
+                         const char *train_command) {
+    if (self->parent) {
+        chaz_Util_die("PGO can only be enabled for the top-level makefile");
+    }
+    if (self->pgo_target) {
+        chaz_Util_die("PGO already enabled");
+    }
+    if (!S_chaz_Make_probe_pgo()) { return 0; }
+
+    self->pgo_target = chaz_Util_strdup(target);
+
+    /* Overridden by the recursive make invocations of the PGO rules. */
+    chaz_MakeFile_add_var(self, "PGO_DIR", NULL);
+    chaz_MakeFile_add_var(self, "PGO_CFLAGS", NULL);
+    chaz_MakeFile_add_var(self, "PGO_LDFLAGS", NULL);
+    chaz_MakeFile_add_var(self, "PGO_MODE", "build");
+    chaz_MakeFile_add_var(self, "PGO_STAMP", "pgo-$(PGO_MODE).stamp");
+    chaz_MakeFile_add_var(self, "PGO_TRAIN", train_command);
+
+    chaz_MakeRule_add_recursive_rm_command(self->clean, CHAZ_MAKE_PGO_DIR);
+    chaz_MakeRule_add_rm_command(self->clean,
+                                 "pgo-build.stamp pgo-instrument.stamp");
+
+    return 1;
 }
 
 void
 chaz_MakeFile_write(chaz_MakeFile *self) {
-    FILE   *out;
-    size_t  i;
+    FILE          *out;
+    chaz_MakeRule *install;
+    chaz_MakeRule *distclean;
+    char          *cc_command;
+    size_t         i;
+
+    if (self->parent) {
+        chaz_Util_die("Only the top-level makefile can be written");
+    }
 
     out = fopen("Makefile", "w");
     if (!out) {
@@ -830,27 +2071,268 @@ chaz_MakeFile_write(chaz_MakeFile *self) {
         fprintf(out, "SHELL = cmd\n");
     }
 
-    fprintf(out, "CC = %s\n", chaz_CC_get_cc());
+    cc_command = S_chaz_Make_cc_value();
+    fprintf(out, "CC = %s\n", cc_command);
     fprintf(out, "LINK = %s\n", chaz_CC_link_command());
+    free(cc_command);
 
-    S_chaz_MakeFile_write_install_vars(out);
+    if (chaz_Make.dep_files) {
+        chaz_CFlags *dep_flags = chaz_CC_new_cflags();
+        chaz_CFlags_generate_dep_files(dep_flags);
+        fprintf(out, "DEPFLAGS = %s\n", chaz_CFlags_get_string(dep_flags));
+        chaz_CFlags_destroy(dep_flags);
+    }
 
-    /* Finalize binary vars. */
-    for (i = 0; self->binaries[i]; i++) {
-        chaz_MakeBinary *binary = self->binaries[i];
-        const char *flags;
+    S_chaz_MakeFile_write_install_vars(self, out, 0);
 
-        flags = chaz_CFlags_get_string(binary->cflags);
-        chaz_MakeVar_append(binary->cflags_var, flags);
-        flags = chaz_CFlags_get_string(binary->ldflags);
-        chaz_MakeVar_append(binary->ldflags_var, flags);
-    }
+    S_chaz_MakeFile_finalize(self);
+
+    S_chaz_MakeFile_write_vars(self, out);
+
+    if (self->fragments[0] && self->rules[0]) {
+        /* Make expands variables in prerequisites immediately, so rules
+         * of the top-level makefile are written after the fragments.
+         * Declare the targets of the first rule to keep the default goal.
+         */
+        chaz_MakeRule *first = self->rules[0];
+
+        for (i = 0; i < first->targets.num_items; i++) {
+            if (i != 0) { fputc(' ', out); }
+            fputs(first->targets.items[i], out);
+        }
+        fprintf(out, " :\n\n");
+    }
+
+    for (i = 0; self->fragments[i]; i++) {
+        S_chaz_MakeFile_write_fragment(self->fragments[i], out);
+    }
+
+    S_chaz_MakeFile_write_rules(self, out);
+
+    install = S_chaz_MakeFile_full_install_rule(self);
+    S_chaz_MakeRule_write(install, out);
+    S_chaz_MakeRule_destroy(install);
+    S_chaz_MakeRule_write(self->clean, out);
+    distclean = S_chaz_MakeFile_full_distclean_rule(self);
+    S_chaz_MakeRule_write(distclean, out);
+    S_chaz_MakeRule_destroy(distclean);
+
+    /* Suffix rule for .c files. */
+    if (chaz_CC_is_msvc()) {
+        chaz_MakeRule *suffix_rule = S_chaz_MakeRule_new(".c.obj", NULL);
+        S_chaz_MakeRule_add_compile_command(suffix_rule,
+                "$(CC) /nologo $(CFLAGS) /c $< /Fo$@");
+        S_chaz_MakeRule_write(suffix_rule, out);
+        S_chaz_MakeRule_destroy(suffix_rule);
+    }
+    else {
+        fprintf(out, ".c.o :\n");
+        fprintf(out, "\t%s $(CFLAGS) -c $< -o $@\n\n",
+                S_chaz_Make_cc_command());
+    }
+
+    S_chaz_MakeFile_write_dep_includes(self, out);
+
+    fclose(out);
+
+    if (chaz_Make.ninja) {
+        S_chaz_MakeFile_write_ninja(self);
+    }
+}
+
+static void
+S_chaz_MakeFile_finalize_binaries(chaz_MakeFile *self) {
+    chaz_MakeFile *root = self->parent ? self->parent : self;
+    size_t i;
+
+    for (i = 0; self->binaries[i]; i++) {
+        chaz_MakeBinary *binary = self->binaries[i];
+        const char *flags;
+
+        if (binary->unity_batch_size) {
+            S_chaz_MakeBinary_finalize_unity(binary);
+        }
+        if (binary->fast_load) {
+            S_chaz_MakeBinary_apply_fast_load(binary);
+        }
+        if (binary->split_debug_info) {
+            S_chaz_MakeBinary_apply_split_debug_info(binary);
+        }
+
+        flags = chaz_CFlags_get_string(binary->cflags);
+        chaz_MakeVar_append(binary->cflags_var, flags);
+        flags = chaz_CFlags_get_string(binary->ldflags);
+        chaz_MakeVar_append(binary->ldflags_var, flags);
+
+        if (root->pgo_target) {
+            /* Instrumented binaries are written to the same paths as the
+             * regular ones. The stamp of the build mode makes sure that
+             * they are relinked when switching modes.
+             */
+            chaz_MakeRule_add_prereq(binary->rule, "$(PGO_STAMP)");
+            S_chaz_MakeBinary_prefix_objs(binary, "$(PGO_DIR)");
+            chaz_MakeVar_append(binary->cflags_var, "$(PGO_CFLAGS)");
+            chaz_MakeVar_append(binary->ldflags_var, "$(PGO_LDFLAGS)");
+        }
+
+        if (binary->type == CHAZ_MAKEBINARY_STATIC_LIB) {
+            S_chaz_MakeBinary_add_archiver_command(binary);
+        }
+    }
+}
+
+static void
+S_chaz_MakeFile_finalize(chaz_MakeFile *self) {
+    size_t i;
+
+    if (self->finalized) { return; }
+    self->finalized = 1;
+
+    S_chaz_MakeFile_finalize_binaries(self);
+    for (i = 0; self->fragments[i]; i++) {
+        S_chaz_MakeFile_finalize_binaries(self->fragments[i]);
+    }
+    if (self->pgo_target) {
+        S_chaz_MakeFile_add_pgo_rules(self);
+    }
+    if (chaz_Make.time_trace_json
+        && chaz_Make.shell_type == CHAZ_OS_POSIX
+       ) {
+        S_chaz_MakeFile_add_build_profile_rule(self);
+    }
+    if (!chaz_Make.supports_grouped_targets) {
+        chaz_MakeFile *mf;
+        size_t k;
+
+        for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+            for (i = 0; mf->rules[i]; i++) {
+                chaz_MakeRule *rule = mf->rules[i];
+                char *stamp;
+
+                if (!rule->grouped || rule->targets.num_items < 2) {
+                    continue;
+                }
+                stamp = S_chaz_MakeRule_stamp_path(rule);
+                chaz_MakeRule_add_rm_command(self->clean, stamp);
+                free(stamp);
+            }
+        }
+    }
+}
+
+static void
+S_chaz_MakeFile_add_build_profile_rule(chaz_MakeFile *self) {
+    /* Clang's traces are single-line JSON. Splitting records at '{'
+     * yields one record per event, except for the arguments of an event
+     * which start the next record.
+     */
+    static const char *const script_lines[] = {
+        "# Generated by Charmonizer.",
+        "# Summarize the JSON files written by Clang's -ftime-trace.",
+        "",
+        "function value(rec, key,    n, s) {",
+        "    n = length(key) + 3",
+        "    if (!match(rec, \"\\\"\" key \"\\\":[^,}]*\")) { return \"\" }",
+        "    s = substr(rec, RSTART + n, RLENGTH - n)",
+        "    gsub(/\"/, \"\", s)",
+        "    return s",
+        "}",
+        "",
+        "BEGIN { RS = \"{\" }",
+        "",
+        "{",
+        "    name = value($0, \"name\")",
+        "    if (source_dur != \"\") {",
+        "        include_time[value($0, \"detail\")] += source_dur",
+        "        source_dur = \"\"",
+        "    }",
+        "    if (name == \"Source\") {",
+        "        source_dur = value($0, \"dur\")",
+        "    }",
+        "    else if (name == \"ExecuteCompiler\") {",
+        "        unit_time[FILENAME] += value($0, \"dur\")",
+        "    }",
+        "}",
+        "",
+        "END {",
+        "    sort = \"sort -rn | head -n 20\"",
+        "    print \"Slowest translation units (ms):\"",
+        "    for (unit in unit_time) {",
+        "        printf \"%10.1f  %s\\n\", unit_time[unit] / 1000,",
+        "               unit | sort",
+        "    }",
+        "    close(sort)",
+        "    print \"\"",
+        "    print \"Most expensive includes (ms, all units):\"",
+        "    for (file in include_time) {",
+        "        printf \"%10.1f  %s\\n\", include_time[file] / 1000,",
+        "               file | sort",
+        "    }",
+        "    close(sort)",
+        "}",
+        NULL
+    };
+    const char *script_path = "build-profile.awk";
+    chaz_MakeStrList lines;
+    chaz_MakeStrList trace_list;
+    chaz_MakeRule *rule;
+    chaz_MakeFile *mf;
+    char *script;
+    char *traces;
+    char *command;
+    size_t i, k;
+
+    memset(&lines, 0, sizeof(lines));
+    memset(&trace_list, 0, sizeof(trace_list));
+
+    for (i = 0; script_lines[i] != NULL; i++) {
+        S_chaz_MakeStrList_push(&lines, script_lines[i]);
+    }
+    /* Terminate the last line. */
+    S_chaz_MakeStrList_push(&lines, "");
+    script = S_chaz_MakeStrList_join(&lines, "\n");
+    chaz_Util_write_file(script_path, script);
+    chaz_MakeRule_add_rm_command(self->distclean, script_path);
+
+    for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+        for (i = 0; mf->binaries[i]; i++) {
+            char *trace = chaz_Util_join("", " $(",
+                                         mf->binaries[i]->obj_var->name, ":",
+                                         chaz_CC_obj_ext(), "=.json)", NULL);
+            S_chaz_MakeStrList_push(&trace_list, trace);
+            free(trace);
+        }
+    }
+    traces = S_chaz_MakeStrList_join(&trace_list, "");
+
+    /* Only summarize the traces of objects that were built. /dev/null
+     * keeps awk from reading stdin if there are none.
+     */
+    command = chaz_Util_join("", "@awk -f ", script_path, " /dev/null `ls",
+                             traces, " 2>/dev/null`", NULL);
+    rule = chaz_MakeFile_add_rule(self, "build-profile", NULL);
+    chaz_MakeRule_add_command(rule, command);
+
+    free(command);
+    free(traces);
+    free(script);
+    S_chaz_MakeStrList_destroy(&trace_list);
+    S_chaz_MakeStrList_destroy(&lines);
+}
+
+static void
+S_chaz_MakeFile_write_vars(chaz_MakeFile *self, FILE *out) {
+    size_t i;
 
     for (i = 0; self->vars[i]; i++) {
-        chaz_MakeVar *var = self->vars[i];
-        fprintf(out, "%s = %s\n", var->name, var->value);
+        S_chaz_MakeVar_write(self->vars[i], out);
     }
     fprintf(out, "\n");
+}
+
+static void
+S_chaz_MakeFile_write_rules(chaz_MakeFile *self, FILE *out) {
+    size_t i;
 
     for (i = 0; self->rules[i]; i++) {
         S_chaz_MakeRule_write(self->rules[i], out);
@@ -859,97 +2341,667 @@ chaz_MakeFile_write(chaz_MakeFile *self) {
     for (i = 0; self->binaries[i]; i++) {
         S_chaz_MakeFile_write_binary_rules(self->binaries[i], out);
     }
+}
 
-    if (self->num_install_dirs) {
-        /* Prepend mkdir commands. */
-        chaz_MakeRule *dummy = S_chaz_MakeRule_new(NULL, NULL);
-        char *commands;
+static void
+S_chaz_MakeFile_write_fragment(chaz_MakeFile *self, FILE *top) {
+    char *path;
+    FILE *out;
 
-        for (i = 0; self->install_dirs[i]; i++) {
-            chaz_MakeRule_add_mkdir_command(dummy, self->install_dirs[i]);
+    if (!chaz_Make.supports_include) {
+        S_chaz_MakeFile_write_vars(self, top);
+        S_chaz_MakeFile_write_rules(self, top);
+        S_chaz_MakeFile_write_dep_includes(self, top);
+        return;
+    }
+
+    path = S_chaz_MakeFile_fragment_path(self);
+    out  = fopen(path, "w");
+    if (!out) {
+        chaz_Util_die("Can't open %s\n", path);
+    }
+
+    S_chaz_MakeFile_write_vars(self, out);
+    S_chaz_MakeFile_write_rules(self, out);
+    S_chaz_MakeFile_write_dep_includes(self, out);
+    fclose(out);
+
+    fprintf(top, "include %s\n\n", path);
+    free(path);
+}
+
+static void
+S_chaz_MakeFile_write_dep_includes(chaz_MakeFile *self, FILE *out) {
+    const char *obj_ext = chaz_CC_obj_ext();
+    size_t i;
+
+    if (chaz_Make.show_includes) {
+        S_chaz_MakeFile_write_nmake_dep_includes(self, out);
+        return;
+    }
+
+    /* Include header dependencies written by the compiler. */
+    if (!chaz_Make.dep_files) { return; }
+
+    for (i = 0; self->binaries[i]; i++) {
+        chaz_MakeBinary *binary = self->binaries[i];
+
+        fprintf(out, "-include $(%s:%s=.d)\n", binary->obj_var->name,
+                obj_ext);
+        if (binary->pch_dep_file) {
+            fprintf(out, "-include %s\n", binary->pch_dep_file);
         }
+    }
+    fprintf(out, "\n");
+}
+
+static void
+S_chaz_MakeFile_write_nmake_dep_includes(chaz_MakeFile *self, FILE *out) {
+    size_t i, j;
 
-        commands = chaz_Util_join("", dummy->commands, self->install->commands,
-                                  NULL);
-        free(self->install->commands);
-        self->install->commands = commands;
+    for (i = 0; self->binaries[i]; i++) {
+        chaz_MakeBinary *binary = self->binaries[i];
+        size_t num_sources = binary->sources.num_items;
+        size_t num_objs    = num_sources + binary->unity_files.num_items;
+
+        for (j = 0; j < num_objs; j++) {
+            const char *source = j < num_sources
+                                 ? binary->sources.items[j]
+                                 : binary->unity_files.items[j-num_sources];
+            char *obj_path = S_chaz_MakeBinary_obj_path(source);
+            char *dep_path;
+
+            if (obj_path == NULL) { continue; }
+
+            if (binary->obj_prefix) {
+                char *prefixed = chaz_Util_join("", binary->obj_prefix,
+                                                obj_path, NULL);
+                free(obj_path);
+                obj_path = prefixed;
+            }
+
+            dep_path = S_chaz_Make_replace_ext(obj_path, ".d");
+            fprintf(out, "!IF EXIST(%s)\n!INCLUDE %s\n!ENDIF\n", dep_path,
+                    dep_path);
+            free(dep_path);
+            free(obj_path);
+        }
+    }
+    fprintf(out, "\n");
+}
 
-        S_chaz_MakeRule_destroy(dummy);
+static void
+S_chaz_MakeFile_add_pgo_rules(chaz_MakeFile *self) {
+    const char *dir_sep = chaz_OS_dir_sep();
+    int cmd_exe = chaz_Make.shell_type == CHAZ_OS_CMD_EXE;
+    chaz_MakeStrList dirs;
+    chaz_MakeFile *mf;
+    chaz_MakeRule *stamp;
+    chaz_MakeRule *instrument;
+    chaz_MakeRule *train;
+    chaz_MakeRule *merge;
+    chaz_MakeRule *optimize;
+    chaz_CFlags *cflags  = chaz_CC_new_cflags();
+    chaz_CFlags *ldflags = chaz_CC_new_cflags();
+    char *pgo_dir = chaz_Util_join("", CHAZ_MAKE_PGO_DIR, dir_sep, NULL);
+    char *profile = chaz_Util_join("", pgo_dir, "default.profdata", NULL);
+    char *command;
+    size_t i, j, k;
+
+    memset(&dirs, 0, sizeof(dirs));
+
+    /* Collect the directories of all objects. Objects of unity files are
+     * written to the top-level directory.
+     */
+    for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+        for (i = 0; mf->binaries[i]; i++) {
+            chaz_MakeBinary *binary = mf->binaries[i];
+
+            for (j = 0; j < binary->sources.num_items; j++) {
+                const char *source = binary->sources.items[j];
+                const char *file   = strrchr(source, dir_sep[0]);
+                char *dir;
+
+                if (file == NULL) { continue; }
+                dir = chaz_Util_strdup(source);
+                dir[file-source] = '\0';
+                S_chaz_MakeStrList_push(&dirs, dir);
+                free(dir);
+            }
+        }
+    }
+    qsort(dirs.items, dirs.num_items, sizeof(char*),
+          S_chaz_MakeStrList_compare);
+
+    /* The stamp of the current build mode. Creating it removes the stamp
+     * of the other mode, so that binaries depending on it are relinked
+     * after switching modes.
+     */
+    stamp = chaz_MakeFile_add_rule(self, "$(PGO_STAMP)", NULL);
+    chaz_MakeRule_add_rm_command(stamp,
+                                 "pgo-build.stamp pgo-instrument.stamp");
+    if (cmd_exe) {
+        chaz_MakeRule_add_command(stamp, "@type nul > $@");
+    }
+    else {
+        chaz_MakeRule_add_command(stamp, "@touch $@");
     }
 
-    S_chaz_MakeRule_write(self->install, out);
-    S_chaz_MakeRule_write(self->clean, out);
-    S_chaz_MakeRule_write(self->distclean, out);
+    /* Build the instrumented binaries with objects in a separate
+     * directory.
+     */
+    instrument = chaz_MakeFile_add_rule(self, "pgo-instrument", NULL);
+    chaz_MakeRule_add_mkdir_command(instrument, CHAZ_MAKE_PGO_DIR);
+    for (i = 0; i < dirs.num_items; i++) {
+        char *dir;
 
-    /* Suffix rule for .c files. */
+        if (i > 0 && strcmp(dirs.items[i], dirs.items[i-1]) == 0) {
+            continue;
+        }
+        dir = chaz_Util_join("", pgo_dir, dirs.items[i], NULL);
+        chaz_MakeRule_add_mkdir_command(instrument, dir);
+        free(dir);
+    }
+    chaz_CFlags_enable_profile_generate(cflags);
+    chaz_CFlags_link_profile_generate(ldflags);
+    command = S_chaz_MakeFile_pgo_make_command(self, pgo_dir, cflags,
+                                               ldflags);
+    chaz_MakeRule_add_command(instrument, command);
+    free(command);
+
+    /* Remove profiles of earlier runs and run the training command. */
+    train = chaz_MakeFile_add_rule(self, "pgo-train", "pgo-instrument");
+    merge = chaz_MakeFile_add_rule(self, "pgo-merge", "pgo-train");
     if (chaz_CC_is_msvc()) {
-        fprintf(out, ".c.obj :\n");
-        fprintf(out, "\t$(CC) /nologo $(CFLAGS) /c $< /Fo$@\n\n");
+        /* The linker merges the .pgc files into the .pgd database. */
+        for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+            for (i = 0; mf->binaries[i]; i++) {
+                chaz_MakeBinary *binary = mf->binaries[i];
+                const char *target = binary->rule->targets.items[0];
+                char *counts = S_chaz_Make_replace_ext(target, "!*.pgc");
+                char *database = S_chaz_Make_replace_ext(target, ".pgd");
+
+                chaz_MakeRule_add_rm_command(train, counts);
+                chaz_MakeRule_add_rm_command(self->clean, counts);
+                chaz_MakeRule_add_rm_command(self->clean, database);
+                free(database);
+                free(counts);
+            }
+        }
+        chaz_MakeRule_add_command(train, "$(PGO_TRAIN)");
+    }
+    else if (chaz_CC_is_clang()) {
+        char *raw_files = chaz_Util_join("", pgo_dir, "*.profraw", NULL);
+
+        chaz_MakeRule_add_rm_command(train, raw_files);
+        if (cmd_exe) {
+            command = chaz_Util_join("", "set LLVM_PROFILE_FILE=%%CD%%\\",
+                                     pgo_dir, "%%p.profraw&& $(PGO_TRAIN)",
+                                     NULL);
+        }
+        else {
+            command = chaz_Util_join("", "LLVM_PROFILE_FILE=\"$(CURDIR)/",
+                                     pgo_dir, "%p.profraw\"; ",
+                                     "export LLVM_PROFILE_FILE; $(PGO_TRAIN)",
+                                     NULL);
+        }
+        chaz_MakeRule_add_command(train, command);
+        free(command);
+
+        command = chaz_Util_join("", chaz_Make.profdata, " merge -output=",
+                                 profile, " ", raw_files, NULL);
+        chaz_MakeRule_add_command(merge, command);
+        free(command);
+        free(raw_files);
     }
     else {
-        fprintf(out, ".c.o :\n");
-        fprintf(out, "\t$(CC) $(CFLAGS) -c $< -o $@\n\n");
+        /* GCC writes the .gcda files next to the instrumented objects.
+         * Copy them next to the objects of the optimized build.
+         */
+        if (cmd_exe) {
+            chaz_MakeRule_add_command(train,
+                "for /r " CHAZ_MAKE_PGO_DIR " %%i in (*.gcda)"
+                " do @del \"%%i\"");
+            chaz_MakeRule_add_command(merge,
+                "xcopy /s /y /q " CHAZ_MAKE_PGO_DIR "\\*.gcda .");
+        }
+        else {
+            chaz_MakeRule_add_command(train,
+                "find " CHAZ_MAKE_PGO_DIR " -name \"*.gcda\""
+                " -exec rm -f {} \\;");
+            chaz_MakeRule_add_command(merge,
+                "cd " CHAZ_MAKE_PGO_DIR " && find . -name \"*.gcda\""
+                " -exec sh -c 'cp \"$$0\" \"../$$0\"' {} \\;");
+        }
+        chaz_MakeRule_add_command(train, "$(PGO_TRAIN)");
+
+        for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+            for (i = 0; mf->binaries[i]; i++) {
+                char *counts = chaz_Util_join("", "$(",
+                                              mf->binaries[i]->obj_var->name,
+                                              ":", chaz_CC_obj_ext(),
+                                              "=.gcda)", NULL);
+                chaz_MakeRule_add_rm_command(self->clean, counts);
+                free(counts);
+            }
+        }
     }
 
-    fclose(out);
+    /* Rebuild all objects with the profiles. */
+    optimize = chaz_MakeFile_add_rule(self, "pgo", "pgo-merge");
+    for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+        for (i = 0; mf->binaries[i]; i++) {
+            chaz_MakeRule_add_rm_command(optimize,
+                                         mf->binaries[i]->obj_dollar_var);
+        }
+    }
+    chaz_CFlags_clear(cflags);
+    chaz_CFlags_clear(ldflags);
+    chaz_CFlags_enable_profile_use(cflags, profile);
+    chaz_CFlags_link_profile_use(ldflags, profile);
+    command = S_chaz_MakeFile_pgo_make_command(self, NULL, cflags, ldflags);
+    chaz_MakeRule_add_command(optimize, command);
+    free(command);
+
+    chaz_CFlags_destroy(ldflags);
+    chaz_CFlags_destroy(cflags);
+    S_chaz_MakeStrList_destroy(&dirs);
+    free(profile);
+    free(pgo_dir);
+}
+
+static char*
+S_chaz_MakeFile_pgo_make_command(chaz_MakeFile *self, const char *dir,
+                                 chaz_CFlags *cflags, chaz_CFlags *ldflags) {
+    char *dir_arg = dir
+                    ? chaz_Util_join("", "PGO_DIR=", dir,
+                                     " PGO_MODE=instrument", NULL)
+                    : NULL;
+    char *command;
+
+    command = chaz_Util_join("", "$(MAKE) ", dir_arg ? dir_arg : "",
+                             dir_arg ? " " : "",
+                             "\"PGO_CFLAGS=", chaz_CFlags_get_string(cflags),
+                             "\" \"PGO_LDFLAGS=",
+                             chaz_CFlags_get_string(ldflags), "\" ",
+                             self->pgo_target, NULL);
+
+    free(dir_arg);
+    return command;
 }
 
 static void
-S_chaz_MakeFile_write_install_vars(FILE *out) {
+S_chaz_MakeFile_write_install_vars(chaz_MakeFile *self, FILE *out,
+                                   int ninja) {
+    /* Name, option, default root and default subdirectory. */
+    static const char *const install_vars[][4] = {
+        { "PREFIX",      "prefix",      "/usr/local",     NULL    },
+        { "BINDIR",      "bindir",      "$(PREFIX)",      "bin"   },
+        { "DATAROOTDIR", "datarootdir", "$(PREFIX)",      "share" },
+        { "DATADIR",     "datadir",     "$(DATAROOTDIR)", NULL    },
+        { "LIBDIR",      "libdir",      "$(PREFIX)",      "lib"   },
+        { "MANDIR",      "mandir",      "$(DATAROOTDIR)", "man"   }
+    };
     const char *dir_sep = chaz_OS_dir_sep();
-    const char *strval;
+    size_t num_vars = sizeof(install_vars) / sizeof(install_vars[0]);
+    size_t i;
+
+    for (i = 0; i < num_vars; i++) {
+        const char *name   = install_vars[i][0];
+        const char *strval = chaz_CLI_strval(chaz_Make.cli,
+                                             install_vars[i][1]);
+        char *value;
+
+        if (strval) {
+            value = chaz_Util_strdup(strval);
+        }
+        else if (install_vars[i][3]) {
+            value = chaz_Util_join(dir_sep, install_vars[i][2],
+                                   install_vars[i][3], NULL);
+        }
+        else {
+            value = chaz_Util_strdup(install_vars[i][2]);
+        }
 
-    strval = chaz_CLI_strval(chaz_Make.cli, "prefix");
-    fprintf(out, "PREFIX = %s\n", strval ? strval : "/usr/local");
+        if (ninja) {
+            chaz_MakeNinjaContext ctx;
+            chaz_MakeStrList elements;
+
+            memset(&ctx, 0, sizeof(ctx));
+            ctx.makefile = self;
+            ctx.out      = out;
+            elements.items     = &value;
+            elements.num_items = 1;
+            elements.cap       = 1;
+            S_chaz_MakeNinja_write_var(&ctx, name, &elements);
+        }
+        else {
+            fprintf(out, "%s = %s\n", name, value);
+        }
 
-    strval = chaz_CLI_strval(chaz_Make.cli, "bindir");
-    if (strval) {
-        fprintf(out, "BINDIR = %s\n", strval);
+        free(value);
     }
-    else {
-        fprintf(out, "BINDIR = $(PREFIX)%sbin\n", dir_sep);
+}
+
+static chaz_MakeRule*
+S_chaz_MakeFile_full_install_rule(chaz_MakeFile *self) {
+    chaz_MakeRule *install = S_chaz_MakeRule_new(NULL, NULL);
+    chaz_MakeRule *orig    = self->install;
+    size_t i;
+
+    for (i = 0; i < orig->targets.num_items; i++) {
+        chaz_MakeRule_add_target(install, orig->targets.items[i]);
+    }
+    for (i = 0; i < orig->prereqs.num_items; i++) {
+        chaz_MakeRule_add_prereq(install, orig->prereqs.items[i]);
+    }
+    for (i = 0; i < self->install_dirs.num_items; i++) {
+        chaz_MakeRule_add_mkdir_command(install, self->install_dirs.items[i]);
+    }
+    for (i = 0; i < orig->commands.num_items; i++) {
+        chaz_MakeRule_add_command(install, orig->commands.items[i]);
     }
 
-    strval = chaz_CLI_strval(chaz_Make.cli, "datarootdir");
-    if (strval) {
-        fprintf(out, "DATAROOTDIR = %s\n", strval);
+    return install;
+}
+
+static chaz_MakeRule*
+S_chaz_MakeFile_full_distclean_rule(chaz_MakeFile *self) {
+    chaz_MakeRule *distclean = S_chaz_MakeRule_new(NULL, NULL);
+    chaz_MakeRule *orig      = self->distclean;
+    size_t i;
+
+    for (i = 0; i < orig->targets.num_items; i++) {
+        chaz_MakeRule_add_target(distclean, orig->targets.items[i]);
     }
-    else {
-        fprintf(out, "DATAROOTDIR = $(PREFIX)%sshare\n", dir_sep);
+    for (i = 0; i < orig->prereqs.num_items; i++) {
+        chaz_MakeRule_add_prereq(distclean, orig->prereqs.items[i]);
+    }
+    for (i = 0; i < orig->commands.num_items; i++) {
+        chaz_MakeRule_add_command(distclean, orig->commands.items[i]);
+    }
+    if (chaz_Make.ninja) {
+        chaz_MakeRule_add_rm_command(distclean,
+                                     "build.ninja .ninja_deps .ninja_log");
     }
 
-    strval = chaz_CLI_strval(chaz_Make.cli, "datadir");
-    fprintf(out, "DATADIR = %s\n", strval ? strval : "$(DATAROOTDIR)");
+    return distclean;
+}
 
-    strval = chaz_CLI_strval(chaz_Make.cli, "libdir");
-    if (strval) {
-        fprintf(out, "LIBDIR = %s\n", strval);
+static void
+S_chaz_MakeFile_write_ninja(chaz_MakeFile *self) {
+    chaz_MakeNinjaContext ctx;
+    chaz_MakeFile *mf;
+    chaz_MakeNinjaObj *objs;
+    chaz_MakeRule *install;
+    chaz_CFlags *output_cflags;
+    chaz_MakeStrList value;
+    const char *cc_value;
+    char *cc_command;
+    size_t num_objs = 0;
+    size_t i, j, k;
+    FILE *out;
+
+    out = fopen("build.ninja", "w");
+    if (!out) {
+        chaz_Util_die("Can't open build.ninja\n");
     }
-    else {
-        fprintf(out, "LIBDIR = $(PREFIX)%slib\n", dir_sep);
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&value, 0, sizeof(value));
+    ctx.makefile = self;
+    ctx.out      = out;
+
+    /* Depfiles with the deps attribute need Ninja 1.3. */
+    fprintf(out, "ninja_required_version = 1.3\n\n");
+
+    /* Ninja evaluates variables immediately, so variables must be written
+     * before they are referenced.
+     */
+    S_chaz_MakeFile_write_install_vars(self, out, 1);
+
+    cc_command = S_chaz_Make_cc_value();
+    value.items     = (char**)&cc_value;
+    value.num_items = 1;
+    cc_value = cc_command;
+    S_chaz_MakeNinja_write_var(&ctx, "CC", &value);
+    free(cc_command);
+    cc_value = chaz_CC_link_command();
+    S_chaz_MakeNinja_write_var(&ctx, "LINK", &value);
+
+    if (chaz_Make.dep_files) {
+        chaz_CFlags *dep_flags = chaz_CC_new_cflags();
+        chaz_CFlags_generate_dep_files(dep_flags);
+        cc_value = chaz_CFlags_get_string(dep_flags);
+        S_chaz_MakeNinja_write_var(&ctx, "DEPFLAGS", &value);
+        chaz_CFlags_destroy(dep_flags);
+    }
+
+    for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+        for (i = 0; mf->vars[i]; i++) {
+            chaz_MakeVar *var = mf->vars[i];
+            S_chaz_MakeNinja_write_var(&ctx, var->name, &var->elements);
+        }
     }
+    fprintf(out, "\n");
+
+    /* Limit the number of concurrent link jobs which tend to be memory
+     * hungry.
+     */
+    fprintf(out, "pool link_pool\n  depth = 2\n\n");
 
-    strval = chaz_CLI_strval(chaz_Make.cli, "mandir");
-    if (strval) {
-        fprintf(out, "MANDIR = %s\n", strval);
+    /* Rule to compile C files. */
+    output_cflags = chaz_CC_new_cflags();
+    chaz_CFlags_set_output_obj(output_cflags, "$out");
+    fprintf(out, "rule cc\n  command = ");
+    S_chaz_MakeNinja_write_string(&ctx, S_chaz_Make_cc_command());
+    if (chaz_CC_is_msvc()) {
+        fprintf(out, " /showIncludes");
     }
-    else {
-        fprintf(out, "MANDIR = $(DATAROOTDIR)%sman\n", dir_sep);
+    fprintf(out, " ${CFLAGS} $cflags $in %s\n",
+            chaz_CFlags_get_string(output_cflags));
+    if (chaz_CC_is_msvc()) {
+        fprintf(out, "  deps = msvc\n");
+    }
+    else if (chaz_Make.dep_files) {
+        fprintf(out, "  depfile = $dep\n  deps = gcc\n");
+    }
+    fprintf(out, "  description = CC $out\n\n");
+    chaz_CFlags_destroy(output_cflags);
+
+    /* Rule to run make commands. */
+    fprintf(out, "rule run\n  command = $cmd\n\n");
+
+    /* Fragments are merged into a single file. */
+    for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+        for (i = 0; mf->rules[i]; i++) {
+            S_chaz_MakeNinja_write_rule(&ctx, mf->rules[i], NULL);
+        }
+    }
+
+    /* Collect object files of all binaries. An object shared by several
+     * binaries is compiled only once, with the flags of the binary that
+     * was added first, since Ninja doesn't allow multiple build statements
+     * for the same output.
+     */
+    for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+        for (i = 0; mf->binaries[i]; i++) {
+            num_objs += mf->binaries[i]->sources.num_items
+                        + mf->binaries[i]->unity_files.num_items;
+        }
+    }
+    objs = (chaz_MakeNinjaObj*)malloc((num_objs + 1)
+                                      * sizeof(chaz_MakeNinjaObj));
+    if (!objs) {
+        chaz_Util_die("Out of memory");
+    }
+    num_objs = 0;
+    for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+        for (i = 0; mf->binaries[i]; i++) {
+            chaz_MakeBinary *binary = mf->binaries[i];
+
+            for (j = 0; j < binary->sources.num_items; j++) {
+                const char *source = binary->sources.items[j];
+                char *obj = S_chaz_MakeBinary_obj_path(source);
+
+                if (obj == NULL) { continue; }
+
+                objs[num_objs].obj    = obj;
+                objs[num_objs].source = source;
+                objs[num_objs].batch  = NULL;
+                objs[num_objs].binary = binary;
+                objs[num_objs].seq    = num_objs;
+                num_objs++;
+            }
+            for (j = 0; j < binary->unity_files.num_items; j++) {
+                const char *source = binary->unity_files.items[j];
+
+                objs[num_objs].obj    = S_chaz_MakeBinary_obj_path(source);
+                objs[num_objs].source = source;
+                objs[num_objs].batch  = &binary->unity_batches[j];
+                objs[num_objs].binary = binary;
+                objs[num_objs].seq    = num_objs;
+                num_objs++;
+            }
+        }
+    }
+    qsort(objs, num_objs, sizeof(chaz_MakeNinjaObj),
+          S_chaz_MakeNinja_compare_objs);
+
+    for (i = 0; i < num_objs; i++) {
+        chaz_MakeNinjaObj *obj = &objs[i];
+        chaz_MakeRule *pch_rule = obj->binary->pch_rule;
+
+        if (i == 0 || strcmp(obj->obj, objs[i-1].obj) != 0) {
+            ctx.is_path = 1;
+            fprintf(out, "build");
+            S_chaz_MakeNinja_write_paths(&ctx, obj->obj, 0);
+            fprintf(out, ": cc");
+            S_chaz_MakeNinja_write_paths(&ctx, obj->source, 0);
+            if (pch_rule || obj->batch) {
+                fprintf(out, " |");
+            }
+            if (obj->batch) {
+                for (j = 0; j < obj->batch->num_items; j++) {
+                    S_chaz_MakeNinja_write_paths(&ctx, obj->batch->items[j],
+                                                 0);
+                }
+            }
+            if (pch_rule) {
+                S_chaz_MakeNinja_write_paths(&ctx, pch_rule->targets.items[0],
+                                             0);
+            }
+            ctx.is_path = 0;
+            fprintf(out, "\n  cflags = ${%s}",
+                    obj->binary->cflags_var->name);
+            if (pch_rule) {
+                fputc(' ', out);
+                S_chaz_MakeNinja_write_string(&ctx, obj->binary->pch_cflags);
+            }
+            fprintf(out, "\n");
+
+            if (chaz_Make.dep_files && !chaz_CC_is_msvc()) {
+                /* The compiler replaces the object extension with ".d". */
+                size_t len = strlen(obj->obj) - strlen(chaz_CC_obj_ext());
+                fprintf(out, "  dep = ");
+                fwrite(obj->obj, 1, len, out);
+                fprintf(out, ".d\n");
+            }
+        }
+    }
+    for (i = 0; i < num_objs; i++) {
+        free(objs[i].obj);
+    }
+    free(objs);
+    fprintf(out, "\n");
+
+    for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+        for (i = 0; mf->binaries[i]; i++) {
+            chaz_MakeBinary *binary = mf->binaries[i];
+
+            S_chaz_MakeNinja_write_rule(&ctx, binary->rule, "link_pool");
+            if (binary->pch_rule) {
+                S_chaz_MakeNinja_write_rule(&ctx, binary->pch_rule, NULL);
+            }
+        }
     }
+
+    install = S_chaz_MakeFile_full_install_rule(self);
+    S_chaz_MakeNinja_write_command_rule(&ctx, install);
+    S_chaz_MakeRule_destroy(install);
+    S_chaz_MakeNinja_write_command_rule(&ctx, self->clean);
+    S_chaz_MakeNinja_write_command_rule(&ctx, self->distclean);
+
+    /* Like make, build the first user rule by default. */
+    if (self->rules[0]) {
+        chaz_MakeRule *rule = self->rules[0];
+
+        ctx.is_path = 1;
+        fprintf(out, "default");
+        for (i = 0; i < rule->targets.num_items; i++) {
+            S_chaz_MakeNinja_write_paths(&ctx, rule->targets.items[i], 0);
+        }
+        ctx.is_path = 0;
+        fprintf(out, "\n");
+    }
+
+    fclose(out);
+}
+
+static chaz_MakeVar*
+S_chaz_MakeFile_find_var(chaz_MakeFile *self, const char *name) {
+    chaz_MakeFile *mf;
+    size_t i, k;
+
+    /* Variables are global across fragments. */
+    while (self->parent) { self = self->parent; }
+
+    for (k = 0; (mf = S_chaz_MakeFile_tree_item(self, k)) != NULL; k++) {
+        for (i = 0; mf->vars[i]; i++) {
+            if (strcmp(mf->vars[i]->name, name) == 0) {
+                return mf->vars[i];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static chaz_MakeFile*
+S_chaz_MakeFile_tree_item(chaz_MakeFile *self, size_t i) {
+    if (i == 0) { return self; }
+    return self->fragments[i-1];
 }
 
 static void
 S_chaz_MakeFile_write_binary_rules(chaz_MakeBinary *binary, FILE *out) {
     const char *cflags_string;
+    const char *pch_target = NULL;
+    char *dollar_var;
 
     S_chaz_MakeRule_write(binary->rule, out);
 
+    if (binary->pch_rule) {
+        S_chaz_MakeRule_write(binary->pch_rule, out);
+        pch_target = binary->pch_rule->targets.items[0];
+    }
+
     cflags_string = chaz_CFlags_get_string(binary->cflags);
+    dollar_var = chaz_Util_join("", "$(", binary->cflags_var->name, ")",
+                                NULL);
+
+    if (binary->pch_rule) {
+        char *cflags = chaz_Util_join(" ", dollar_var, binary->pch_cflags,
+                                      NULL);
+        free(dollar_var);
+        dollar_var = cflags;
+    }
 
-    /* Write rules to compile with custom flags. */
-    if (cflags_string[0] != '\0') {
-        char *dollar_var = chaz_Util_join("", "$(", binary->cflags_var->name,
-                                          ")", NULL);
+    /* Write rules to compile with custom flags or to custom object
+     * paths.
+     */
+    if (cflags_string[0] != '\0' || binary->pch_rule || binary->obj_prefix) {
+        const char *prefix = binary->obj_prefix;
 
         if (!chaz_Make.supports_pattern_rules
             || chaz_Make.shell_type == CHAZ_OS_CMD_EXE) {
@@ -958,194 +3010,643 @@ S_chaz_MakeFile_write_binary_rules(chaz_MakeBinary *binary, FILE *out) {
              * mingw32-make which has problems with pattern rules and
              * backslash directory separators.
              */
-            S_chaz_MakeFile_write_object_rules(binary->sources, dollar_var,
-                                               out);
+            S_chaz_MakeFile_write_object_rules(&binary->sources, prefix,
+                                               dollar_var, pch_target, out);
+        }
+        else {
+            /* Write a pattern rule for each directory. */
+            S_chaz_MakeFile_write_pattern_rules(&binary->dirs, prefix,
+                                                dollar_var, pch_target, out);
+            /* Write a rule for each object added with add_src_file. */
+            S_chaz_MakeFile_write_object_rules(&binary->single_sources,
+                                               prefix, dollar_var,
+                                               pch_target, out);
+        }
+    }
+
+    S_chaz_MakeFile_write_unity_rules(binary, dollar_var, pch_target, out);
+
+    free(dollar_var);
+}
+
+static void
+S_chaz_MakeFile_write_unity_rules(chaz_MakeBinary *binary, const char *cflags,
+                                  const char *prereq, FILE *out) {
+    const char *cc = S_chaz_Make_cc_command();
+    chaz_CFlags *output_cflags = chaz_CC_new_cflags();
+    const char *output_cflags_string;
+    size_t i, j;
+
+    chaz_CFlags_set_output_obj(output_cflags, "$@");
+    output_cflags_string = chaz_CFlags_get_string(output_cflags);
+
+    for (i = 0; i < binary->unity_files.num_items; i++) {
+        const char *source = binary->unity_files.items[i];
+        chaz_MakeStrList *batch = &binary->unity_batches[i];
+        char *obj_path = S_chaz_MakeBinary_obj_path(source);
+        chaz_MakeRule *rule;
+        char *command;
+
+        if (binary->obj_prefix) {
+            char *prefixed = chaz_Util_join("", binary->obj_prefix, obj_path,
+                                            NULL);
+            free(obj_path);
+            obj_path = prefixed;
+        }
+
+        rule = S_chaz_MakeRule_new(obj_path, source);
+        for (j = 0; j < batch->num_items; j++) {
+            chaz_MakeRule_add_prereq(rule, batch->items[j]);
+        }
+        if (prereq) { chaz_MakeRule_add_prereq(rule, prereq); }
+        command = chaz_Util_join(" ", cc, "$(CFLAGS)", cflags, source,
+                                 output_cflags_string, NULL);
+        S_chaz_MakeRule_add_compile_command(rule, command);
+        S_chaz_MakeRule_write(rule, out);
+
+        free(command);
+        S_chaz_MakeRule_destroy(rule);
+        free(obj_path);
+    }
+
+    chaz_CFlags_destroy(output_cflags);
+}
+
+static void
+S_chaz_MakeFile_write_object_rules(chaz_MakeStrList *sources,
+                                   const char *obj_prefix,
+                                   const char *cflags, const char *prereq,
+                                   FILE *out) {
+    const char *cc = S_chaz_Make_cc_command();
+    chaz_CFlags *output_cflags = chaz_CC_new_cflags();
+    const char *output_cflags_string;
+    size_t i;
+
+    chaz_CFlags_set_output_obj(output_cflags, "$@");
+    output_cflags_string = chaz_CFlags_get_string(output_cflags);
+
+    for (i = 0; i < sources->num_items; i++) {
+        const char *source = sources->items[i];
+        char *obj_path = S_chaz_MakeBinary_obj_path(source);
+        chaz_MakeRule *rule;
+        char *command;
+
+        if (obj_path == NULL) { continue; }
+
+        if (obj_prefix) {
+            char *prefixed = chaz_Util_join("", obj_prefix, obj_path, NULL);
+            free(obj_path);
+            obj_path = prefixed;
+        }
+
+        rule = S_chaz_MakeRule_new(obj_path, source);
+        if (prereq) { chaz_MakeRule_add_prereq(rule, prereq); }
+        command = chaz_Util_join(" ", cc, "$(CFLAGS)", cflags, source,
+                                 output_cflags_string, NULL);
+        S_chaz_MakeRule_add_compile_command(rule, command);
+        S_chaz_MakeRule_write(rule, out);
+
+        free(command);
+        S_chaz_MakeRule_destroy(rule);
+        free(obj_path);
+    }
+
+    chaz_CFlags_destroy(output_cflags);
+}
+
+static void
+S_chaz_MakeFile_write_pattern_rules(chaz_MakeStrList *dirs,
+                                    const char *obj_prefix,
+                                    const char *cflags, const char *prereq,
+                                    FILE *out) {
+    const char *cc = S_chaz_Make_cc_command();
+    const char *obj_ext = chaz_CC_obj_ext();
+    const char *dir_sep = chaz_OS_dir_sep();
+    chaz_CFlags *output_cflags = chaz_CC_new_cflags();
+    const char *output_cflags_string;
+    char *command;
+    size_t i;
+
+    chaz_CFlags_set_output_obj(output_cflags, "$@");
+    output_cflags_string = chaz_CFlags_get_string(output_cflags);
+    command  = chaz_Util_join(" ", cc, "$(CFLAGS)", cflags, "$<",
+                              output_cflags_string, NULL);
+
+    for (i = 0; i < dirs->num_items; i++) {
+        const char *dir = dirs->items[i];
+        char *target = chaz_Util_join("", obj_prefix ? obj_prefix : "", dir,
+                                      dir_sep, "%", obj_ext, NULL);
+        char *src    = chaz_Util_join("", dir, dir_sep, "%.c", NULL);
+        chaz_MakeRule *rule = S_chaz_MakeRule_new(target, src);
+
+        if (prereq) { chaz_MakeRule_add_prereq(rule, prereq); }
+        chaz_MakeRule_add_command(rule, command);
+        S_chaz_MakeRule_write(rule, out);
+
+        S_chaz_MakeRule_destroy(rule);
+        free(src);
+        free(target);
+    }
+
+    free(command);
+    chaz_CFlags_destroy(output_cflags);
+}
+
+void
+chaz_MakeVar_append(chaz_MakeVar *self, const char *element) {
+    if (element[0] == '\0') { return; }
+    S_chaz_MakeStrList_push(&self->elements, element);
+}
+
+static void
+S_chaz_MakeVar_write(chaz_MakeVar *self, FILE *out) {
+    chaz_MakeStrList *elements = &self->elements;
+    size_t i;
+
+    fprintf(out, "%s = ", self->name);
+
+    /* Write elements directly instead of building the whole value in
+     * memory. Multiple elements are put on separate lines. */
+    if (elements->num_items == 1) {
+        fputs(elements->items[0], out);
+    }
+    else {
+        for (i = 0; i < elements->num_items; i++) {
+            fprintf(out, "%s\\\n    %s", i == 0 ? "" : " ",
+                    elements->items[i]);
+        }
+    }
+
+    fprintf(out, "\n");
+}
+
+static chaz_MakeRule*
+S_chaz_MakeRule_new(const char *target, const char *prereq) {
+    chaz_MakeRule *rule = (chaz_MakeRule*)calloc(1, sizeof(chaz_MakeRule));
+
+    if (target) { chaz_MakeRule_add_target(rule, target); }
+    if (prereq) { chaz_MakeRule_add_prereq(rule, prereq); }
+
+    return rule;
+}
+
+static void
+S_chaz_MakeRule_destroy(chaz_MakeRule *self) {
+    S_chaz_MakeStrList_destroy(&self->targets);
+    S_chaz_MakeStrList_destroy(&self->prereqs);
+    S_chaz_MakeStrList_destroy(&self->commands);
+    free(self);
+}
+
+static void
+S_chaz_MakeRule_write(chaz_MakeRule *self, FILE *out) {
+    const char *separator = " :";
+    size_t i;
+
+    if (self->grouped && self->targets.num_items > 1) {
+        if (!chaz_Make.supports_grouped_targets) {
+            S_chaz_MakeRule_write_stamped(self, out);
+            return;
+        }
+        separator = " &:";
+    }
+
+    for (i = 0; i < self->targets.num_items; i++) {
+        if (i != 0) { fputc(' ', out); }
+        fputs(self->targets.items[i], out);
+    }
+    fputs(separator, out);
+    for (i = 0; i < self->prereqs.num_items; i++) {
+        fprintf(out, " %s", self->prereqs.items[i]);
+    }
+    fprintf(out, "\n");
+    for (i = 0; i < self->commands.num_items; i++) {
+        fprintf(out, "\t%s\n", self->commands.items[i]);
+    }
+    fprintf(out, "\n");
+}
+
+static void
+S_chaz_MakeRule_add_compile_command(chaz_MakeRule *self,
+                                    const char *command) {
+    /* cl prints included files to stdout with this prefix unless the
+     * messages are localized. The remaining lines are diagnostics.
+     */
+    static const char note_filter[] =
+        "/c:\"Note: including file:\" $*.showincludes";
+    char *compile;
+    char *convert;
+
+    if (!chaz_Make.show_includes) {
+        chaz_MakeRule_add_command(self, command);
+        return;
+    }
+
+    /* Capture the output of the compiler. Show the diagnostics and fail
+     * if the compilation fails.
+     */
+    compile = chaz_Util_join("", command, " /showIncludes > $*.showincludes",
+                             " || (findstr /v /b ", note_filter,
+                             " & del $*.showincludes & exit 1)", NULL);
+    /* Show the diagnostics and write a dependency line for every
+     * included file to $*.d.
+     */
+    convert = chaz_Util_join("", "@findstr /v /b ", note_filter,
+                             " & type nul > $*.d",
+                             " & (for /f \"tokens=3,*\" %%a in",
+                             " ('findstr /b ", note_filter, "')",
+                             " do @echo $@ : \"%%b\" >> $*.d)",
+                             " & del $*.showincludes", NULL);
+    chaz_MakeRule_add_command(self, compile);
+    chaz_MakeRule_add_command(self, convert);
+
+    free(convert);
+    free(compile);
+}
+
+static void
+S_chaz_MakeRule_write_stamped(chaz_MakeRule *self, FILE *out) {
+    char *stamp  = S_chaz_MakeRule_stamp_path(self);
+    chaz_MakeRule *recipe = S_chaz_MakeRule_new(stamp, NULL);
+    char *command;
+    size_t i;
+
+    /* The targets only depend on the stamp. The empty recipe keeps make
+     * from searching for implicit rules. Unlike a recipe that runs make
+     * recursively, this also works in parallel builds.
+     */
+    for (i = 0; i < self->targets.num_items; i++) {
+        fprintf(out, "%s ", self->targets.items[i]);
+    }
+    fprintf(out, ": %s ;\n\n", stamp);
+
+    for (i = 0; i < self->prereqs.num_items; i++) {
+        chaz_MakeRule_add_prereq(recipe, self->prereqs.items[i]);
+    }
+    for (i = 0; i < self->commands.num_items; i++) {
+        chaz_MakeRule_add_command(recipe, self->commands.items[i]);
+    }
+    if (chaz_Make.shell_type == CHAZ_OS_POSIX) {
+        command = chaz_Util_join(" ", "@touch", stamp, NULL);
+    }
+    else {
+        command = chaz_Util_join(" ", "@type nul >", stamp, NULL);
+    }
+    chaz_MakeRule_add_command(recipe, command);
+    free(command);
+
+    S_chaz_MakeRule_write(recipe, out);
+
+    S_chaz_MakeRule_destroy(recipe);
+    free(stamp);
+}
+
+static char*
+S_chaz_MakeRule_stamp_path(chaz_MakeRule *self) {
+    return chaz_Util_join("", self->targets.items[0], ".stamp", NULL);
+}
+
+static void
+S_chaz_MakeNinja_write_string(chaz_MakeNinjaContext *ctx, const char *string) {
+    FILE *out = ctx->out;
+    const char *p = string;
+
+    while (*p != '\0') {
+        if (*p != '$') {
+            if (ctx->is_path && (*p == ' ' || *p == ':')) {
+                fputc('$', out);
+            }
+            else if (ctx->is_command
+                     && chaz_Make.shell_type == CHAZ_OS_CMD_EXE
+                     && p[0] == '%' && p[1] == '%') {
+                /* Commands are run with `cmd /c`, not from a batch file. */
+                p++;
+            }
+            fputc(*p, out);
+            p++;
+            continue;
+        }
+
+        p++;
+        if (*p == '$') {
+            fputs("$$", out);
+            p++;
+        }
+        else if (*p == '@' && ctx->target) {
+            S_chaz_MakeNinja_write_string(ctx, ctx->target);
+            p++;
+        }
+        else if (*p == '<' && ctx->source) {
+            S_chaz_MakeNinja_write_string(ctx, ctx->source);
+            p++;
+        }
+        else if (*p == '(' || *p == '{') {
+            const char *end = strchr(p, *p == '(' ? ')' : '}');
+            if (end == NULL) {
+                chaz_Util_die("Unterminated variable reference in '%s'",
+                              string);
+            }
+            S_chaz_MakeNinja_write_ref(ctx, p + 1, end - (p + 1));
+            p = end + 1;
+        }
+        else if (*p != '\0') {
+            fprintf(out, "${%c}", *p);
+            p++;
+        }
+    }
+}
+
+static void
+S_chaz_MakeNinja_write_ref(chaz_MakeNinjaContext *ctx, const char *ref,
+                           size_t len) {
+    FILE *out = ctx->out;
+    char *name = (char*)malloc(len + 1);
+    char *from;
+    char *to;
+
+    memcpy(name, ref, len);
+    name[len] = '\0';
+
+    from = strchr(name, ':');
+    if (from) {
+        /* Expand substitution reference $(NAME:from=to). */
+        chaz_MakeVar *var;
+        size_t from_len;
+        size_t i;
+
+        *from++ = '\0';
+        to = strchr(from, '=');
+        if (to == NULL) {
+            chaz_Util_die("Invalid substitution reference '$(%s)'", ref);
+        }
+        *to++ = '\0';
+        from_len = strlen(from);
+
+        var = S_chaz_MakeFile_find_var(ctx->makefile, name);
+        if (var == NULL) {
+            chaz_Util_die("Unknown make variable '%s'", name);
+        }
+
+        for (i = 0; i < var->elements.num_items; i++) {
+            const char *elem = var->elements.items[i];
+            size_t elem_len = strlen(elem);
+
+            if (i != 0) { fputc(' ', out); }
+
+            if (elem_len >= from_len
+                && strcmp(elem + elem_len - from_len, from) == 0
+               ) {
+                char *subst = (char*)malloc(elem_len - from_len
+                                            + strlen(to) + 1);
+                memcpy(subst, elem, elem_len - from_len);
+                strcpy(subst + elem_len - from_len, to);
+                S_chaz_MakeNinja_write_string(ctx, subst);
+                free(subst);
+            }
+            else {
+                S_chaz_MakeNinja_write_string(ctx, elem);
+            }
+        }
+    }
+    else if (strcmp(name, "MAKE") == 0) {
+        const char *make = chaz_Make.make_command;
+        fputs(make ? make : "make", out);
+    }
+    else if (strcmp(name, "CURDIR") == 0) {
+        if (chaz_Make.shell_type == CHAZ_OS_CMD_EXE) {
+            fputs("%CD%", out);
+        }
+        else {
+            fputs("$$PWD", out);
+        }
+    }
+    else {
+        fprintf(out, "${%s}", name);
+    }
+
+    free(name);
+}
+
+static void
+S_chaz_MakeNinja_write_paths(chaz_MakeNinjaContext *ctx, const char *paths,
+                             int depth) {
+    const char *p = paths;
+
+    while (*p != '\0') {
+        const char *start;
+        size_t len;
+        chaz_MakeVar *var = NULL;
+        char *path;
+
+        if (isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+
+        start = p;
+        while (*p != '\0' && !isspace((unsigned char)*p)) { p++; }
+        len = p - start;
+
+        path = (char*)malloc(len + 1);
+        memcpy(path, start, len);
+        path[len] = '\0';
+
+        if (len > 3
+            && path[0] == '$'
+            && path[1] == '('
+            && path[len-1] == ')'
+            && strcspn(path + 2, "$:") == len - 2
+            && depth < 10
+           ) {
+            path[len-1] = '\0';
+            var = S_chaz_MakeFile_find_var(ctx->makefile, path + 2);
+            path[len-1] = ')';
+        }
+
+        if (var) {
+            size_t i;
+
+            for (i = 0; i < var->elements.num_items; i++) {
+                S_chaz_MakeNinja_write_paths(ctx, var->elements.items[i],
+                                             depth + 1);
+            }
         }
         else {
-            /* Write a pattern rule for each directory. */
-            S_chaz_MakeFile_write_pattern_rules(binary->dirs, dollar_var, out);
-            /* Write a rule for each object added with add_src_file. */
-            S_chaz_MakeFile_write_object_rules(binary->single_sources,
-                                               dollar_var, out);
+            fputc(' ', ctx->out);
+            S_chaz_MakeNinja_write_string(ctx, path);
         }
 
-        free(dollar_var);
+        free(path);
     }
 }
 
 static void
-S_chaz_MakeFile_write_object_rules(char **sources, const char *cflags,
-                                   FILE *out) {
-    const char *cc = chaz_CC_is_msvc() ? "$(CC) /nologo" : "$(CC)";
-    chaz_CFlags *output_cflags = chaz_CC_new_cflags();
-    const char *output_cflags_string;
+S_chaz_MakeNinja_write_var(chaz_MakeNinjaContext *ctx, const char *name,
+                           chaz_MakeStrList *elements) {
+    FILE *out = ctx->out;
     size_t i;
 
-    chaz_CFlags_set_output_obj(output_cflags, "$@");
-    output_cflags_string = chaz_CFlags_get_string(output_cflags);
-
-    for (i = 0; sources[i]; i++) {
-        const char *source = sources[i];
-        char *obj_path = S_chaz_MakeBinary_obj_path(source);
-        chaz_MakeRule *rule;
-        char *command;
-
-        if (obj_path == NULL) { continue; }
-
-        rule = S_chaz_MakeRule_new(obj_path, source);
-        command = chaz_Util_join(" ", cc, "$(CFLAGS)", cflags, source,
-                                 output_cflags_string, NULL);
-        chaz_MakeRule_add_command(rule, command);
-        S_chaz_MakeRule_write(rule, out);
+    fprintf(out, "%s =", name);
 
-        free(command);
-        S_chaz_MakeRule_destroy(rule);
-        free(obj_path);
+    /* Multiple elements are put on separate lines like in the Makefile. */
+    if (elements->num_items == 1) {
+        fputc(' ', out);
+        S_chaz_MakeNinja_write_string(ctx, elements->items[0]);
+    }
+    else {
+        for (i = 0; i < elements->num_items; i++) {
+            fprintf(out, " $\n    ");
+            S_chaz_MakeNinja_write_string(ctx, elements->items[i]);
+        }
     }
 
-    chaz_CFlags_destroy(output_cflags);
+    fprintf(out, "\n");
 }
 
 static void
-S_chaz_MakeFile_write_pattern_rules(char **dirs, const char *cflags,
-                                    FILE *out) {
-    const char *cc = chaz_CC_is_msvc() ? "$(CC) /nologo" : "$(CC)";
-    const char *obj_ext = chaz_CC_obj_ext();
-    const char *dir_sep = chaz_OS_dir_sep();
-    chaz_CFlags *output_cflags = chaz_CC_new_cflags();
-    const char *output_cflags_string;
-    char *command;
+S_chaz_MakeNinja_write_rule(chaz_MakeNinjaContext *ctx, chaz_MakeRule *rule,
+                            const char *pool) {
+    FILE *out = ctx->out;
+    chaz_MakeStrList *commands = &rule->commands;
     size_t i;
 
-    chaz_CFlags_set_output_obj(output_cflags, "$@");
-    output_cflags_string = chaz_CFlags_get_string(output_cflags);
-    command  = chaz_Util_join(" ", cc, "$(CFLAGS)", cflags, "$<",
-                              output_cflags_string, NULL);
-
-    for (i = 0; dirs[i]; i++) {
-        const char *dir = dirs[i];
-        char *target = chaz_Util_join("", dir, dir_sep, "%", obj_ext,
-                                      NULL);
-        char *prereq = chaz_Util_join("", dir, dir_sep, "%.c", NULL);
-        chaz_MakeRule *rule = S_chaz_MakeRule_new(target, prereq);
-
-        chaz_MakeRule_add_command(rule, command);
-        S_chaz_MakeRule_write(rule, out);
+    if (rule->targets.num_items == 0) { return; }
 
-        S_chaz_MakeRule_destroy(rule);
-        free(prereq);
-        free(target);
+    ctx->is_path = 1;
+    fprintf(out, "build");
+    for (i = 0; i < rule->targets.num_items; i++) {
+        S_chaz_MakeNinja_write_paths(ctx, rule->targets.items[i], 0);
+    }
+    fprintf(out, commands->num_items ? ": run" : ": phony");
+    for (i = 0; i < rule->prereqs.num_items; i++) {
+        S_chaz_MakeNinja_write_paths(ctx, rule->prereqs.items[i], 0);
     }
+    ctx->is_path = 0;
+    fprintf(out, "\n");
 
-    free(command);
-    chaz_CFlags_destroy(output_cflags);
-}
+    if (commands->num_items) {
+        /* $@ and $< aren't available in build scope, so they're replaced
+         * with the first target and prerequisite.
+         */
+        ctx->target     = rule->targets.items[0];
+        ctx->source     = rule->prereqs.num_items
+                          ? rule->prereqs.items[0] : NULL;
+        ctx->is_command = 1;
+
+        fprintf(out, "  cmd = ");
+        if (chaz_Make.shell_type == CHAZ_OS_CMD_EXE) {
+            fprintf(out, "cmd /c ");
+        }
+        for (i = 0; i < commands->num_items; i++) {
+            const char *command = commands->items[i];
 
-void
-chaz_MakeVar_append(chaz_MakeVar *self, const char *element) {
-    char *value;
+            /* Strip make's echo suppression prefix. */
+            while (*command == '@' || isspace((unsigned char)*command)) {
+                command++;
+            }
 
-    if (element[0] == '\0') { return; }
+            if (i != 0) { fprintf(out, " && "); }
+            S_chaz_MakeNinja_write_string(ctx, command);
+        }
+        fprintf(out, "\n");
 
-    if (self->num_elements == 0) {
-        value = chaz_Util_strdup(element);
+        ctx->target     = NULL;
+        ctx->source     = NULL;
+        ctx->is_command = 0;
     }
-    else {
-        value = (char*)malloc(strlen(self->value) + strlen(element) + 20);
 
-        if (self->num_elements == 1) {
-            sprintf(value, "\\\n    %s \\\n    %s", self->value, element);
-        }
-        else {
-            sprintf(value, "%s \\\n    %s", self->value, element);
-        }
+    if (pool) {
+        fprintf(out, "  pool = %s\n", pool);
     }
 
-    free(self->value);
-    self->value = value;
-    self->num_elements++;
+    fprintf(out, "\n");
 }
 
-static chaz_MakeRule*
-S_chaz_MakeRule_new(const char *target, const char *prereq) {
-    chaz_MakeRule *rule = (chaz_MakeRule*)malloc(sizeof(chaz_MakeRule));
+static void
+S_chaz_MakeNinja_write_command_rule(chaz_MakeNinjaContext *ctx,
+                                    chaz_MakeRule *rule) {
+    chaz_MakeRule *edge;
+    size_t i;
 
-    rule->targets  = NULL;
-    rule->prereqs  = NULL;
-    rule->commands = NULL;
+    if (rule->commands.num_items == 0) {
+        S_chaz_MakeNinja_write_rule(ctx, rule, NULL);
+        return;
+    }
 
-    if (target) { chaz_MakeRule_add_target(rule, target); }
-    if (prereq) { chaz_MakeRule_add_prereq(rule, prereq); }
+    edge = S_chaz_MakeRule_new(NULL, NULL);
+    for (i = 0; i < rule->targets.num_items; i++) {
+        char *output = chaz_Util_join("", "_charm_", rule->targets.items[i],
+                                      NULL);
+        chaz_MakeRule_add_target(edge, output);
+        free(output);
+    }
+    for (i = 0; i < rule->prereqs.num_items; i++) {
+        chaz_MakeRule_add_prereq(edge, rule->prereqs.items[i]);
+    }
+    for (i = 0; i < rule->commands.num_items; i++) {
+        chaz_MakeRule_add_command(edge, rule->commands.items[i]);
+    }
+    S_chaz_MakeNinja_write_rule(ctx, edge, NULL);
+
+    for (i = 0; i < rule->targets.num_items; i++) {
+        ctx->is_path = 1;
+        fprintf(ctx->out, "build");
+        S_chaz_MakeNinja_write_paths(ctx, rule->targets.items[i], 0);
+        fprintf(ctx->out, ": phony");
+        S_chaz_MakeNinja_write_paths(ctx, edge->targets.items[i], 0);
+        ctx->is_path = 0;
+        fprintf(ctx->out, "\n\n");
+    }
 
-    return rule;
+    S_chaz_MakeRule_destroy(edge);
 }
 
-static void
-S_chaz_MakeRule_destroy(chaz_MakeRule *self) {
-    if (self->targets)  { free(self->targets); }
-    if (self->prereqs)  { free(self->prereqs); }
-    if (self->commands) { free(self->commands); }
-    free(self);
-}
+static int
+S_chaz_MakeNinja_compare_objs(const void *va, const void *vb) {
+    const chaz_MakeNinjaObj *a = (const chaz_MakeNinjaObj*)va;
+    const chaz_MakeNinjaObj *b = (const chaz_MakeNinjaObj*)vb;
+    int result = strcmp(a->obj, b->obj);
 
-static void
-S_chaz_MakeRule_write(chaz_MakeRule *self, FILE *out) {
-    fprintf(out, "%s :", self->targets);
-    if (self->prereqs) {
-        fprintf(out, " %s", self->prereqs);
-    }
-    fprintf(out, "\n");
-    if (self->commands) {
-        fprintf(out, "%s", self->commands);
-    }
-    fprintf(out, "\n");
+    if (result != 0) { return result; }
+
+    return a->seq < b->seq ? -1 : a->seq > b->seq ? 1 : 0;
 }
 
 void
 chaz_MakeRule_add_target(chaz_MakeRule *self, const char *target) {
-    char *targets;
-
-    if (!self->targets) {
-        targets = chaz_Util_strdup(target);
+    if (self->grouped) {
+        S_chaz_MakeStrList_push_words(&self->targets, target);
     }
     else {
-        targets = chaz_Util_join(" ", self->targets, target, NULL);
-        free(self->targets);
+        S_chaz_MakeStrList_push(&self->targets, target);
     }
-
-    self->targets = targets;
 }
 
 void
 chaz_MakeRule_add_prereq(chaz_MakeRule *self, const char *prereq) {
-    char *prereqs;
-
-    if (!self->prereqs) {
-        prereqs = chaz_Util_strdup(prereq);
-    }
-    else {
-        prereqs = chaz_Util_join(" ", self->prereqs, prereq, NULL);
-        free(self->prereqs);
-    }
-
-    self->prereqs = prereqs;
+    S_chaz_MakeStrList_push(&self->prereqs, prereq);
 }
 
 void
-chaz_MakeRule_add_command(chaz_MakeRule *self, const char *command) {
-    char *commands;
+chaz_MakeRule_group_targets(chaz_MakeRule *self) {
+    chaz_MakeStrList targets;
+    size_t i;
 
-    if (!self->commands) {
-        commands = (char*)malloc(strlen(command) + 20);
-        sprintf(commands, "\t%s\n", command);
-    }
-    else {
-        commands = (char*)malloc(strlen(self->commands) + strlen(command) + 20);
-        sprintf(commands, "%s\t%s\n", self->commands, command);
-        free(self->commands);
+    if (self->grouped) { return; }
+    self->grouped = 1;
+
+    /* Split targets that were passed as a single string. */
+    memset(&targets, 0, sizeof(targets));
+    for (i = 0; i < self->targets.num_items; i++) {
+        S_chaz_MakeStrList_push_words(&targets, self->targets.items[i]);
     }
+    S_chaz_MakeStrList_destroy(&self->targets);
+    self->targets = targets;
+}
 
-    self->commands = commands;
+void
+chaz_MakeRule_add_command(chaz_MakeRule *self, const char *command) {
+    S_chaz_MakeStrList_push(&self->commands, command);
 }
 
 void
@@ -1244,18 +3745,21 @@ S_chaz_MakeBinary_destroy(chaz_MakeBinary *self) {
     free(self->obj_dollar_var);
     S_chaz_MakeRule_destroy(self->rule);
 
-    for (i = 0; i < self->num_sources; i++) {
-        free(self->sources[i]);
-    }
-    free(self->sources);
-    for (i = 0; i < self->num_single_sources; i++) {
-        free(self->single_sources[i]);
+    if (self->pch_rule) {
+        S_chaz_MakeRule_destroy(self->pch_rule);
+        free(self->pch_cflags);
+        free(self->pch_dep_file);
     }
-    free(self->single_sources);
-    for (i = 0; i < self->num_dirs; i++) {
-        free(self->dirs[i]);
+
+    for (i = 0; i < self->unity_files.num_items; i++) {
+        S_chaz_MakeStrList_destroy(&self->unity_batches[i]);
     }
-    free(self->dirs);
+    free(self->unity_batches);
+    S_chaz_MakeStrList_destroy(&self->unity_files);
+
+    S_chaz_MakeStrList_destroy(&self->sources);
+    S_chaz_MakeStrList_destroy(&self->single_sources);
+    S_chaz_MakeStrList_destroy(&self->dirs);
 
     chaz_CFlags_destroy(self->cflags);
     chaz_CFlags_destroy(self->ldflags);
@@ -1266,9 +3770,6 @@ S_chaz_MakeBinary_destroy(chaz_MakeBinary *self) {
 void
 chaz_MakeBinary_add_src_file(chaz_MakeBinary *self, const char *dir,
                              const char *filename) {
-    size_t num_sources = self->num_single_sources;
-    size_t alloc_size  = (num_sources + 2) * sizeof(char*);
-    char **sources = (char**)realloc(self->single_sources, alloc_size);
     char *path;
 
     if (dir == NULL || strcmp(dir, ".") == 0) {
@@ -1280,12 +3781,10 @@ chaz_MakeBinary_add_src_file(chaz_MakeBinary *self, const char *dir,
     }
 
     /* Add to single_sources. */
-    sources[num_sources]     = path;
-    sources[num_sources+1]   = NULL;
-    self->single_sources     = sources;
-    self->num_single_sources = num_sources + 1;
-
+    S_chaz_MakeStrList_push(&self->single_sources, path);
     S_chaz_MakeBinary_do_add_src_file(self, path);
+
+    free(path);
 }
 
 void
@@ -1298,13 +3797,8 @@ chaz_MakeBinary_add_filtered_src_dir(chaz_MakeBinary *self, const char *path,
                                      chaz_Make_file_filter_t filter,
                                      void *filter_ctx) {
     chaz_MakeBinaryContext context;
-    size_t num_dirs = self->num_dirs;
-    char **dirs = (char**)realloc(self->dirs, (num_dirs + 2) * sizeof(char*));
 
-    dirs[num_dirs]   = chaz_Util_strdup(path);
-    dirs[num_dirs+1] = NULL;
-    self->dirs     = dirs;
-    self->num_dirs = num_dirs + 1;
+    S_chaz_MakeStrList_push(&self->dirs, path);
 
     context.binary     = self;
     context.filter     = filter;
@@ -1331,15 +3825,9 @@ S_chaz_MakeBinary_list_files_callback(const char *dir, char *file,
 
 static void
 S_chaz_MakeBinary_do_add_src_file(chaz_MakeBinary *self, const char *path) {
-    size_t num_sources = self->num_sources;
-    size_t alloc_size  = (num_sources + 2) * sizeof(char*);
-    char **sources = (char**)realloc(self->sources, alloc_size);
     char *obj_path;
 
-    sources[num_sources]   = chaz_Util_strdup(path);
-    sources[num_sources+1] = NULL;
-    self->sources     = sources;
-    self->num_sources = num_sources + 1;
+    S_chaz_MakeStrList_push(&self->sources, path);
 
     obj_path = S_chaz_MakeBinary_obj_path(path);
     if (obj_path == NULL) {
@@ -1375,35 +3863,399 @@ S_chaz_MakeBinary_obj_path(const char *src_path) {
 }
 
 void
-chaz_MakeBinary_add_prereq(chaz_MakeBinary *self, const char *prereq) {
-    chaz_MakeRule_add_prereq(self->rule, prereq);
+chaz_MakeBinary_set_pch(chaz_MakeBinary *self, const char *header) {
+    chaz_MakeRule *clean = chaz_MakeFile_clean_rule(self->makefile);
+    chaz_CFlags *use_cflags;
+    char *tag;
+    char *pch;
+    char *cflags;
+    char *command;
+    char *stub     = NULL;
+    char *stub_obj = NULL;
+
+    if (self->pch_rule) {
+        chaz_Util_die("Precompiled header already set");
+    }
+    if (!S_chaz_Make_probe_pch()) { return; }
+
+    /* Binaries can be compiled with different flags, so every binary gets
+     * its own PCH named after the binary's variable.
+     */
+    tag = S_chaz_MakeBinary_tag(self);
+    pch = S_chaz_Make_pch_path(header, tag);
+
+    if (chaz_CC_is_msvc()) {
+        /* MSVC creates the PCH while compiling a source file. The
+         * resulting object file must be linked into the binary.
+         */
+        stub     = S_chaz_Make_replace_ext(pch, ".c");
+        stub_obj = S_chaz_MakeBinary_obj_path(stub);
+        chaz_Util_write_file(stub, "/* Creates a precompiled header. */\n");
+        chaz_MakeVar_append(self->obj_var, stub_obj);
+        chaz_MakeRule_add_rm_command(
+            chaz_MakeFile_distclean_rule(self->makefile), stub);
+        self->pch_rule = S_chaz_MakeRule_new(stub_obj, header);
+        chaz_MakeRule_add_rm_command(clean, pch);
+    }
+    else {
+        self->pch_rule = S_chaz_MakeRule_new(pch, header);
+        if (chaz_Make.dep_files) {
+            self->pch_dep_file = S_chaz_Make_replace_ext(pch, ".d");
+        }
+
+        if (chaz_CC_is_clang()) {
+            chaz_MakeRule_add_rm_command(clean, pch);
+            if (self->pch_dep_file) {
+                chaz_MakeRule_add_rm_command(clean, self->pch_dep_file);
+            }
+        }
+        else {
+            char *dir = chaz_Util_join("", header, ".gch", NULL);
+            chaz_MakeRule_add_mkdir_command(self->pch_rule, dir);
+            chaz_MakeRule_add_recursive_rm_command(clean, dir);
+            free(dir);
+        }
+    }
+
+    cflags  = chaz_Util_join("", "$(CFLAGS) $(", self->cflags_var->name, ")",
+                             NULL);
+    command = S_chaz_Make_pch_command(S_chaz_Make_cc_command(), cflags,
+                                      header, pch, stub, stub_obj);
+    chaz_MakeRule_add_command(self->pch_rule, command);
+
+    use_cflags = chaz_CC_new_cflags();
+    chaz_CFlags_use_pch(use_cflags, header, pch);
+    self->pch_cflags = chaz_Util_strdup(chaz_CFlags_get_string(use_cflags));
+
+    chaz_CFlags_destroy(use_cflags);
+    free(command);
+    free(cflags);
+    free(stub_obj);
+    free(stub);
+    free(pch);
+    free(tag);
 }
 
-char*
-chaz_MakeBinary_obj_string(chaz_MakeBinary *self) {
-    char *retval = chaz_Util_strdup("");
+static char*
+S_chaz_MakeBinary_tag(chaz_MakeBinary *self) {
+    const char *obj_var_name = self->obj_var->name;
+    char *tag = chaz_Util_strdup(obj_var_name);
+    size_t i;
+
+    tag[strlen(obj_var_name) - sizeof("_OBJS") + 1] = '\0';
+    for (i = 0; tag[i] != '\0'; i++) {
+        tag[i] = tolower((unsigned char)tag[i]);
+    }
+
+    return tag;
+}
+
+void
+chaz_MakeBinary_enable_unity_build(chaz_MakeBinary *self, size_t batch_size,
+                                   chaz_Make_file_filter_t filter,
+                                   void *filter_ctx) {
+    self->unity_batch_size = batch_size ? batch_size : (size_t)-1;
+    self->unity_filter     = filter;
+    self->unity_filter_ctx = filter_ctx;
+}
+
+void
+chaz_MakeBinary_enable_split_debug_info(chaz_MakeBinary *self) {
+    S_chaz_Make_probe_debug_info();
+    self->split_debug_info = 1;
+}
+
+static void
+S_chaz_MakeBinary_apply_split_debug_info(chaz_MakeBinary *self) {
+    if (chaz_Make.split_dwarf) {
+        chaz_MakeRule *clean = chaz_MakeFile_clean_rule(self->makefile);
+        char *dwo_files = chaz_Util_join("", "$(", self->obj_var->name, ":",
+                                         chaz_CC_obj_ext(), "=.dwo)", NULL);
+
+        chaz_CFlags_split_debug_info(self->cflags);
+        chaz_MakeRule_add_rm_command(clean, dwo_files);
+        free(dwo_files);
+    }
+
+    if (self->type == CHAZ_MAKEBINARY_STATIC_LIB) { return; }
+
+    if (chaz_Make.compress_debug) {
+        chaz_CFlags_compress_debug_sections(self->ldflags,
+                                            chaz_Make.compress_debug);
+    }
+    /* The index speeds up loading split debug info in GDB. */
+    if (chaz_Make.split_dwarf && chaz_Make.gdb_index) {
+        chaz_CFlags_link_gdb_index(self->ldflags);
+    }
+}
+
+void
+chaz_MakeBinary_enable_fast_load(chaz_MakeBinary *self) {
+    S_chaz_Make_probe_fast_load();
+    self->fast_load = 1;
+}
+
+static void
+S_chaz_MakeBinary_apply_fast_load(chaz_MakeBinary *self) {
+    chaz_CFlags *cflags  = chaz_CC_new_cflags();
+    chaz_CFlags *ldflags = chaz_CC_new_cflags();
+    chaz_CFlags *sources[4];
+    const char *string;
+    int i;
+
+    /* Prepend the link flags, so --as-needed applies to all libraries. */
+    sources[0] = chaz_Make.fast_load_cflags;
+    sources[1] = self->cflags;
+    for (i = 0; i < 2; i++) {
+        string = chaz_CFlags_get_string(sources[i]);
+        if (string[0] != '\0') { chaz_CFlags_append(cflags, string); }
+    }
+
+    i = 0;
+    if (self->type != CHAZ_MAKEBINARY_STATIC_LIB) {
+        sources[i++] = chaz_Make.fast_load_ldflags;
+    }
+    if (self->type == CHAZ_MAKEBINARY_SHARED_LIB) {
+        sources[i++] = chaz_Make.fast_load_shared_ldflags;
+    }
+    sources[i++] = self->ldflags;
+    sources[i]   = NULL;
+    for (i = 0; sources[i] != NULL; i++) {
+        string = chaz_CFlags_get_string(sources[i]);
+        if (string[0] != '\0') { chaz_CFlags_append(ldflags, string); }
+    }
+
+    chaz_CFlags_destroy(self->cflags);
+    chaz_CFlags_destroy(self->ldflags);
+    self->cflags  = cflags;
+    self->ldflags = ldflags;
+}
+
+int
+chaz_MakeBinary_enable_thin_archive(chaz_MakeBinary *self) {
+    if (self->type != CHAZ_MAKEBINARY_STATIC_LIB) {
+        chaz_Util_die("Thin archives require a static library");
+    }
+    self->thin_archive = chaz_CC_archiver_supports_thin();
+    return self->thin_archive;
+}
+
+static void
+S_chaz_MakeBinary_add_archiver_command(chaz_MakeBinary *self) {
+    chaz_MakeStrList *elements = &self->obj_var->elements;
+    const char *objects = self->obj_dollar_var;
+    char *rsp_arg = NULL;
+    char *command;
+    size_t i;
+
+    /* Response files are written when the makefile is generated, so they
+     * can't reference make variables like $(PGO_DIR).
+     */
+    for (i = 0; i < elements->num_items; i++) {
+        if (strchr(elements->items[i], '$')) { break; }
+    }
+
+    if (i == elements->num_items && chaz_CC_archiver_supports_rsp()) {
+        chaz_MakeRule *distclean
+            = chaz_MakeFile_distclean_rule(self->makefile);
+        char *rsp_path
+            = S_chaz_Make_replace_ext(chaz_MakeBinary_get_target(self),
+                                      ".rsp");
+        char *content = S_chaz_MakeStrList_join(elements, "\n");
+        char *rsp_content;
+        char *p;
+
+        /* GNU ar treats backslashes in response files as escape
+         * characters. All supported archivers accept forward slashes.
+         */
+        for (p = content; *p != '\0'; p++) {
+            if (*p == '\\') { *p = '/'; }
+        }
+        rsp_content = chaz_Util_join("", content, "\n", NULL);
+
+        chaz_Util_write_file(rsp_path, rsp_content);
+        chaz_MakeRule_add_rm_command(distclean, rsp_path);
+        rsp_arg = chaz_Util_join("", "@", rsp_path, NULL);
+        objects = rsp_arg;
+
+        free(rsp_content);
+        free(content);
+        free(rsp_path);
+    }
+
+    if (self->thin_archive) {
+        /* Existing archives can't be converted to thin archives. */
+        chaz_MakeRule_add_rm_command(self->rule, "$@");
+        command = chaz_CC_format_thin_archiver_command("$@", objects);
+    }
+    else {
+        command = chaz_CC_format_archiver_command("$@", objects);
+    }
+    chaz_MakeRule_add_command(self->rule, command);
+
+    free(command);
+    free(rsp_arg);
+}
+
+static void
+S_chaz_MakeBinary_finalize_unity(chaz_MakeBinary *self) {
+    chaz_MakeRule *distclean = chaz_MakeFile_distclean_rule(self->makefile);
+    const char *dir_sep = chaz_OS_dir_sep();
+    chaz_MakeStrList batched;
+    chaz_MakeStrList batched_objs;
+    char *tag = S_chaz_MakeBinary_tag(self);
+    size_t num_files;
     size_t i;
 
-    for (i = 0; i < self->num_sources; i++) {
-        const char *sep = retval[0] == '\0' ? "" : " ";
-        char *obj_path = S_chaz_MakeBinary_obj_path(self->sources[i]);
-        char *tmp;
+    memset(&batched, 0, sizeof(batched));
+    memset(&batched_objs, 0, sizeof(batched_objs));
+
+    for (i = 0; i < self->sources.num_items; i++) {
+        const char *source = self->sources.items[i];
+        const char *file   = strrchr(source, dir_sep[0]);
+        char *obj_path = S_chaz_MakeBinary_obj_path(source);
+        int include = 1;
 
         if (obj_path == NULL) { continue; }
 
-        tmp = chaz_Util_join("", retval, sep, obj_path, NULL);
-        free(retval);
-        retval = tmp;
+        if (self->unity_filter) {
+            char *dir;
+            char *filename;
+
+            if (file) {
+                size_t dir_len = file - source;
+                dir = (char*)malloc(dir_len + 1);
+                memcpy(dir, source, dir_len);
+                dir[dir_len] = '\0';
+                filename = chaz_Util_strdup(file + 1);
+            }
+            else {
+                dir      = chaz_Util_strdup(".");
+                filename = chaz_Util_strdup(source);
+            }
+            include = self->unity_filter(dir, filename,
+                                         self->unity_filter_ctx) != 0;
+            free(filename);
+            free(dir);
+        }
+
+        if (include) {
+            S_chaz_MakeStrList_push(&batched, source);
+            S_chaz_MakeStrList_push(&batched_objs, obj_path);
+        }
+        free(obj_path);
+    }
+
+    /* Write the unity files. */
+    num_files = batched.num_items == 0
+                ? 0
+                : (batched.num_items - 1) / self->unity_batch_size + 1;
+    self->unity_batches = (chaz_MakeStrList*)calloc(num_files + 1,
+                                                    sizeof(chaz_MakeStrList));
+    if (!self->unity_batches) {
+        chaz_Util_die("Out of memory");
+    }
+    for (i = 0; i < num_files; i++) {
+        chaz_MakeStrList *batch = &self->unity_batches[i];
+        size_t start = i * self->unity_batch_size;
+        size_t end   = batched.num_items - start > self->unity_batch_size
+                       ? start + self->unity_batch_size
+                       : batched.num_items;
+        char num_buf[32];
+        char *path;
+        char *obj_path;
+        char *includes;
+        char *content;
+        size_t j;
+
+        for (j = start; j < end; j++) {
+            S_chaz_MakeStrList_push(batch, batched.items[j]);
+        }
+
+        sprintf(num_buf, "%lu", (unsigned long)(i + 1));
+        path = chaz_Util_join("", tag, "_unity_", num_buf, ".c", NULL);
+        includes = S_chaz_MakeStrList_join(batch, "\"\n#include \"");
+        content  = chaz_Util_join("", "/* Generated by Charmonizer. */\n\n"
+                                  "#include \"", includes, "\"\n", NULL);
+        chaz_Util_write_file(path, content);
+        chaz_MakeRule_add_rm_command(distclean, path);
+
+        obj_path = S_chaz_MakeBinary_obj_path(path);
+        S_chaz_MakeStrList_push(&self->unity_files, path);
+        chaz_MakeVar_append(self->obj_var, obj_path);
 
         free(obj_path);
+        free(content);
+        free(includes);
+        free(path);
     }
 
-    return retval;
+    /* The included sources aren't compiled separately. */
+    qsort(batched.items, batched.num_items, sizeof(char*),
+          S_chaz_MakeStrList_compare);
+    qsort(batched_objs.items, batched_objs.num_items, sizeof(char*),
+          S_chaz_MakeStrList_compare);
+    S_chaz_MakeStrList_remove(&self->sources, &batched);
+    S_chaz_MakeStrList_remove(&self->single_sources, &batched);
+    S_chaz_MakeStrList_remove(&self->obj_var->elements, &batched_objs);
+
+    S_chaz_MakeStrList_destroy(&batched_objs);
+    S_chaz_MakeStrList_destroy(&batched);
+    free(tag);
+}
+
+static void
+S_chaz_MakeBinary_prefix_objs(chaz_MakeBinary *self, const char *prefix) {
+    chaz_MakeStrList *elements = &self->obj_var->elements;
+    chaz_MakeStrList objs;
+    size_t i;
+
+    memset(&objs, 0, sizeof(objs));
+
+    for (i = 0; i < self->sources.num_items; i++) {
+        char *obj_path = S_chaz_MakeBinary_obj_path(self->sources.items[i]);
+        if (obj_path == NULL) { continue; }
+        S_chaz_MakeStrList_push(&objs, obj_path);
+        free(obj_path);
+    }
+    for (i = 0; i < self->unity_files.num_items; i++) {
+        char *obj_path
+            = S_chaz_MakeBinary_obj_path(self->unity_files.items[i]);
+        S_chaz_MakeStrList_push(&objs, obj_path);
+        free(obj_path);
+    }
+    qsort(objs.items, objs.num_items, sizeof(char*),
+          S_chaz_MakeStrList_compare);
+
+    /* Other objects like the one creating an MSVC PCH keep their path. */
+    for (i = 0; i < elements->num_items; i++) {
+        char *element = elements->items[i];
+
+        if (bsearch(&element, objs.items, objs.num_items, sizeof(char*),
+                    S_chaz_MakeStrList_compare)) {
+            elements->items[i] = chaz_Util_join("", prefix, element, NULL);
+            free(element);
+        }
+    }
+
+    self->obj_prefix = prefix;
+    S_chaz_MakeStrList_destroy(&objs);
+}
+
+void
+chaz_MakeBinary_add_prereq(chaz_MakeBinary *self, const char *prereq) {
+    chaz_MakeRule_add_prereq(self->rule, prereq);
+}
+
+char*
+chaz_MakeBinary_obj_string(chaz_MakeBinary *self) {
+    /* The object variable holds the objects of all valid sources. */
+    return S_chaz_MakeStrList_join(&self->obj_var->elements, " ");
 }
 
 const char*
 chaz_MakeBinary_get_target(chaz_MakeBinary *self) {
-    return self->rule->targets;
+    return self->rule->targets.items[0];
 }
 
 chaz_CFlags*
@@ -1425,9 +4277,13 @@ chaz_Make_list_files(const char *dir, const char *ext,
     char       *list;
     char       *prefix;
     char       *file;
+    char      **files;
     size_t      command_size;
     size_t      list_len;
     size_t      prefix_len;
+    size_t      max_files;
+    size_t      num_files = 0;
+    size_t      i;
 
     /* List files using shell. */
 
@@ -1487,7 +4343,16 @@ chaz_Make_list_files(const char *dir, const char *ext,
         free(output);
     }
 
-    /* Iterate file list and invoke callback. */
+    /* Collect and sort file list. The order in which the shell lists files
+     * depends on the file system. Sorting makes the generated makefiles
+     * identical across machines and checkouts.
+     */
+
+    max_files = 1;
+    for (i = 0; i < list_len; i++) {
+        if (list[i] == '\n') { max_files++; }
+    }
+    files = (char**)malloc(max_files * sizeof(char*));
 
     for (file = strtok(list, "\r\n"); file; file = strtok(NULL, "\r\n")) {
         if (strlen(file) <= prefix_len
@@ -1497,9 +4362,18 @@ chaz_Make_list_files(const char *dir, const char *ext,
                           file);
         }
 
-        callback(dir, file + prefix_len, context);
+        files[num_files++] = file + prefix_len;
+    }
+
+    qsort(files, num_files, sizeof(char*), S_chaz_MakeStrList_compare);
+
+    /* Iterate file list and invoke callback. */
+
+    for (i = 0; i < num_files; i++) {
+        callback(dir, files[i], context);
     }
 
+    free(files);
     free(prefix);
     free(list);
 }
@@ -38,6 +38,20 @@ typedef int
 (*chaz_Make_file_filter_t)(const char *dir, char *file, void *context);
 
 /** Initialize the environment.
+ *
+ * If the option `--enable-build-profiling` is given, all sources are
+ * compiled with -ftime-trace (Clang) or -ftime-report (GCC). With Clang,
+ * the target `build-profile` summarizes the slowest translation units and
+ * the most expensive includes.
+ *
+ * If the option `--enable-compiler-cache` is given, the compiler command in
+ * generated makefiles is prefixed with ccache or sccache. The link command
+ * is never wrapped.
+ *
+ * If the option `--linker` is given, binaries are linked with the named
+ * linker. `--linker=fast` selects the first working linker out of mold,
+ * lld and gold. Otherwise, the default linker of the compiler driver is
+ * used.
  *
  * @param make_command Name of the make command. Auto-detect if NULL.
  */
@@ -60,7 +74,8 @@ int
 chaz_Make_shell_type(void);
 
 /** Recursively list files in a directory. For every file a callback is called
- * with the filename and a context variable.
+ * with the filename and a context variable. Files are reported in sorted
+ * order, with paths relative to `dir`.
  *
  * @param dir Directory to search in.
  * @param ext File extension to search for.
@@ -104,6 +119,27 @@ chaz_MakeRule*
 chaz_MakeFile_add_rule(chaz_MakeFile *self, const char *target,
                        const char *prereq);
 
+/** Add a fragment for a subdirectory. The fragment is written to a file
+ * named 'Makefile.inc' in the subdirectory which is included by the
+ * top-level Makefile. This way, a single make process sees all targets of
+ * the tree and can schedule them in parallel, unlike recursive make
+ * invocations.
+ *
+ * Fragments support all MakeFile methods except chaz_MakeFile_write and
+ * chaz_MakeFile_add_fragment. Since all commands run from the top-level
+ * directory, paths must be relative to that directory. Variable names are
+ * global and must not clash across fragments. Since make expands variables
+ * in prerequisites immediately, variables of a fragment can only be used in
+ * prerequisites of later fragments and of the top-level makefile. The
+ * 'install', 'clean' and 'distclean' rules of a fragment are the ones of the
+ * top-level makefile.
+ *
+ * @param dir The subdirectory.
+ * @return a MakeFile which is owned by the top-level makefile.
+ */
+chaz_MakeFile*
+chaz_MakeFile_add_fragment(chaz_MakeFile *self, const char *dir);
+
 /** Return the rule for the 'install' target.
  */
 chaz_MakeRule*
@@ -203,7 +239,43 @@ void
 chaz_MakeFile_install_pkgconfig(chaz_MakeFile *self, const char *name,
                                 const char *version, const char *content);
 
+/** Add targets for profile-guided optimization of all binaries:
+ *
+ * - 'pgo-instrument' builds the target with instrumentation. The objects
+ *   are written to the 'pgo-gen' directory. Binaries are written to their
+ *   regular paths and relinked by the next regular build.
+ * - 'pgo-train' runs the training command to collect profiles.
+ * - 'pgo-merge' merges the profiles if the compiler requires it.
+ * - 'pgo' rebuilds the target optimized with the profiles. The objects are
+ *   the ones of a regular build.
+ *
+ * Must be called on the top-level makefile. If the compiler doesn't support
+ * any of the steps, no targets are added.
+ *
+ * @param target The target to build, typically 'all'.
+ * @param train_command The command to run the instrumented binaries. Can
+ * be overridden with the make variable PGO_TRAIN.
+ * @return true if PGO is supported.
+ */
+int
+chaz_MakeFile_enable_pgo(chaz_MakeFile *self, const char *target,
+                         const char *train_command);
+
 /** Write the makefile to a file named 'Makefile' in the current directory.
+ *
+ * If the compiler can emit dependency files and the make utility can include
+ * them, objects are recompiled automatically when headers change.
+ *
+ * If the `--enable-ninja` option was given, a file named 'build.ninja' with
+ * the same targets is written as well. Header dependencies are tracked with
+ * Ninja's depfile support and link jobs are run in a separate pool.
+ * Ninja's own files are only removed by the 'distclean' target of the
+ * Makefile.
+ *
+ * MSVC doesn't write dependency files. For nmake, the /showIncludes output
+ * of every compilation is converted to a fragment next to the object file
+ * with the stock tools of cmd.exe, and the fragments are included with
+ * `!IF EXIST(...)`. build.ninja uses Ninja's own /showIncludes parser.
  */
 void
 chaz_MakeFile_write(chaz_MakeFile *self);
@@ -230,6 +302,18 @@ chaz_MakeRule_add_target(chaz_MakeRule *self, const char *target);
 void
 chaz_MakeRule_add_prereq(chaz_MakeRule *self, const char *prereq);
 
+/** Declare that a single run of the rule's commands creates all of its
+ * targets. Uses grouped targets (`&:`) if supported by the make utility
+ * and a stamp file otherwise, so that the commands never run more than
+ * once, even in parallel builds.
+ *
+ * Targets passed as a whitespace-separated string are split into separate
+ * targets. Variable references are not expanded, so each must name a
+ * single file.
+ */
+void
+chaz_MakeRule_group_targets(chaz_MakeRule *self);
+
 /** Add a command to a rule.
  *
  * @param command The additional command.
@@ -258,7 +342,8 @@ chaz_MakeRule_add_rm_command(chaz_MakeRule *self, const char *files);
 void
 chaz_MakeRule_add_recursive_rm_command(chaz_MakeRule *self, const char *dirs);
 
-/** Add one or more commands to call another makefile recursively.
+/** Add one or more commands to call another makefile recursively. See
+ * chaz_MakeFile_add_fragment for a non-recursive alternative.
  *
  * @param dir The directory in which to call the makefile.
  * @param target The target to call. Pass NULL for the default target.
@@ -296,6 +381,68 @@ chaz_MakeBinary_add_filtered_src_dir(chaz_MakeBinary *self, const char *path,
                                      chaz_Make_file_filter_t filter,
                                      void *context);
 
+/** Use a precompiled header for all sources of the binary. The header is
+ * compiled with the same flags as the sources and included automatically
+ * before the first line of each source file. Objects are rebuilt when the
+ * precompiled header changes.
+ *
+ * If the compiler doesn't support precompiled headers, this method does
+ * nothing.
+ *
+ * @param header The path to the header file.
+ */
+void
+chaz_MakeBinary_set_pch(chaz_MakeBinary *self, const char *header);
+
+/** Compile the sources of the binary as a unity build. When the makefile is
+ * written, files named "<binary>_unity_N.c" are created which `#include`
+ * batches of the binary's C sources. These files are compiled instead of
+ * the individual sources. Sources rejected by the filter are compiled
+ * separately, for example files with conflicting static declarations.
+ *
+ * @param batch_size The maximum number of sources per unity file. 0 puts
+ * all sources into a single file.
+ * @param filter A callback that is invoked for every source file with the
+ * directory and the file name. The source is only included in a unity file
+ * if the callback returns true. May be NULL.
+ * @param filter_ctx Context passed to filter. Must stay valid until the
+ * makefile is written.
+ */
+void
+chaz_MakeBinary_enable_unity_build(chaz_MakeBinary *self, size_t batch_size,
+                                   chaz_Make_file_filter_t filter,
+                                   void *filter_ctx);
+
+/** Build the binary with the fast load profile. Supported flags from the
+ * following set are applied: -Wl,-O1, -Wl,--hash-style=gnu,
+ * -Wl,--as-needed, -ffunction-sections and -fdata-sections with
+ * -Wl,--gc-sections, -fno-semantic-interposition and, for shared
+ * libraries, -Wl,-Bsymbolic-functions. This results in smaller binaries
+ * which load faster. MSVC uses /Gy with /OPT:REF and /OPT:ICF.
+ *
+ * Shared libraries built this way don't support interposition of their
+ * functions, for example with LD_PRELOAD.
+ */
+void
+chaz_MakeBinary_enable_fast_load(chaz_MakeBinary *self);
+
+/** Split debug info into .dwo files with -gsplit-dwarf, compress the debug
+ * sections of linked binaries and let the linker create a GDB index if the
+ * toolchain supports it. This reduces the amount of data the linker has to
+ * process. The flags have no effect unless debug info is enabled.
+ */
+void
+chaz_MakeBinary_enable_split_debug_info(chaz_MakeBinary *self);
+
+/** Create a static library as thin archive which only references the
+ * object files instead of copying them. Only use this for intermediate
+ * libraries that are never installed.
+ *
+ * @return true if the archiver supports thin archives, false otherwise.
+ */
+int
+chaz_MakeBinary_enable_thin_archive(chaz_MakeBinary *self);
+
 /** Add a prerequisite to the make rule of the binary.
  *
  * @param prereq The prerequisite.
@@ -42,6 +42,12 @@ chaz_Probe_parse_cli_args(int argc, const char *argv[], chaz_CLI *cli) {
     chaz_CLI_register(cli, "enable-ruby", "generate charmony.rb", CHAZ_CLI_NO_ARG);
     chaz_CLI_register(cli, "enable-makefile", NULL, CHAZ_CLI_NO_ARG);
     chaz_CLI_register(cli, "enable-coverage", NULL, CHAZ_CLI_NO_ARG);
+    chaz_CLI_register(cli, "enable-ninja", "generate build.ninja", CHAZ_CLI_NO_ARG);
+    chaz_CLI_register(cli, "enable-lto", "link-time optimization", CHAZ_CLI_NO_ARG);
+    chaz_CLI_register(cli, "enable-thin-lto", "ThinLTO if supported", CHAZ_CLI_NO_ARG);
+    chaz_CLI_register(cli, "enable-build-profiling", "compile time reports", CHAZ_CLI_NO_ARG);
+    chaz_CLI_register(cli, "enable-compiler-cache", "ccache or sccache", CHAZ_CLI_NO_ARG);
+    chaz_CLI_register(cli, "linker", "mold, lld, gold or fast", CHAZ_CLI_ARG_OPTIONAL);
     chaz_CLI_register(cli, "cc", "compiler command", CHAZ_CLI_ARG_REQUIRED);
     chaz_CLI_register(cli, "cflags", NULL, CHAZ_CLI_ARG_OPTIONAL);
     chaz_CLI_register(cli, "make", "make command", CHAZ_CLI_ARG_OPTIONAL);
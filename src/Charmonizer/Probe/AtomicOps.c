@@ -23,11 +23,52 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/* Module vars. */
+static struct {
+    int has_stdatomic_h;
+    int has_c11_atomics;
+    int has_gnuc_atomics;
+    int has_gnuc_sync;
+    int has_interlocked;
+} chaz_AtomicOps = { 0, 0, 0, 0, 0 };
+
+/* Check for atomic operations on words and pointers with C11 atomics, the
+ * __atomic and __sync builtins and the Interlocked intrinsics.  The test
+ * programs are linked without libatomic, so that operations which need
+ * locks from libatomic aren't detected.
+ */
+static void
+chaz_AtomicOps_probe_backends(void);
+
+/* Check whether 8-byte atomics work without libatomic and determine the
+ * lock-free properties of the atomic types.
+ */
+static void
+chaz_AtomicOps_probe_lock_free(void);
+
+/* Evaluate a lock-free macro at compile time and define `sym` to its
+ * value.
+ */
+static void
+chaz_AtomicOps_probe_lock_free_macro(const char *sym, const char *macro,
+                                     const char *includes);
+
+/* Check for a 128-bit compare-and-swap and the flags it needs.
+ */
+static void
+chaz_AtomicOps_probe_cas128(void);
+
+/* Write the chy_atomic_* macros for the fastest backend.
+ */
+static void
+chaz_AtomicOps_write_layer(void);
+
 void
 chaz_AtomicOps_run(void) {
     chaz_ConfWriter_start_module("AtomicOps");
 
     if (chaz_HeadCheck_check_header("stdatomic.h")) {
+        chaz_AtomicOps.has_stdatomic_h = true;
         chaz_ConfWriter_add_def("HAS_STDATOMIC_H", NULL);
     }
     if (chaz_HeadCheck_check_header("libkern/OSAtomic.h")) {
@@ -50,8 +91,403 @@ chaz_AtomicOps_run(void) {
         chaz_ConfWriter_add_def("HAS_INTRIN_H", NULL);
     }
 
+    chaz_AtomicOps_probe_backends();
+    chaz_AtomicOps_probe_lock_free();
+    chaz_AtomicOps_probe_cas128();
+    chaz_AtomicOps_write_layer();
+
     chaz_ConfWriter_end_module();
 }
 
+static void
+chaz_AtomicOps_probe_backends(void) {
+    static const char c11_code[] =
+        "#include <stdatomic.h>\n"
+        "static _Atomic(long) x;\n"
+        "static _Atomic(void*) p;\n"
+        "int main() {\n"
+        "    void *ptr = 0;\n"
+        "    atomic_store_explicit(&x, 1, memory_order_release);\n"
+        "    atomic_fetch_add_explicit(&x, 1, memory_order_relaxed);\n"
+        "    atomic_compare_exchange_strong_explicit(\n"
+        "        &p, &ptr, (void*)&x, memory_order_acq_rel,\n"
+        "        memory_order_acquire);\n"
+        "    atomic_thread_fence(memory_order_seq_cst);\n"
+        "    return (int)atomic_load_explicit(&x, memory_order_acquire);\n"
+        "}\n";
+    static const char gnuc_atomic_code[] =
+        "static long x;\n"
+        "static void *p;\n"
+        "int main() {\n"
+        "    void *ptr = 0;\n"
+        "    __atomic_store_n(&x, 1, __ATOMIC_RELEASE);\n"
+        "    __atomic_fetch_add(&x, 1, __ATOMIC_RELAXED);\n"
+        "    __atomic_compare_exchange_n(&p, &ptr, (void*)&x, 0,\n"
+        "        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);\n"
+        "    __atomic_thread_fence(__ATOMIC_SEQ_CST);\n"
+        "    return __atomic_load_n(&x, __ATOMIC_ACQUIRE) == 2 ? 0 : 1;\n"
+        "}\n";
+    static const char gnuc_sync_code[] =
+        "static long x;\n"
+        "static void *p;\n"
+        "int main() {\n"
+        "    __sync_fetch_and_add(&x, 1);\n"
+        "    __sync_val_compare_and_swap(&p, (void*)0, (void*)&x);\n"
+        "    __sync_synchronize();\n"
+        "    return x == 1 ? 0 : 1;\n"
+        "}\n";
+    static const char interlocked_code[] =
+        "#include <intrin.h>\n"
+        "static volatile long x;\n"
+        "static volatile __int64 y;\n"
+        "int main() {\n"
+        "    _InterlockedCompareExchange(&x, 1, 0);\n"
+        "    _InterlockedCompareExchange64(&y, 1, 0);\n"
+        "    _InterlockedExchangeAdd(&x, 1);\n"
+        "    _InterlockedExchangeAdd64(&y, 1);\n"
+        "    _mm_mfence();\n"
+        "    return x == 2 ? 0 : 1;\n"
+        "}\n";
+
+    if (chaz_AtomicOps.has_stdatomic_h && chaz_CC_test_link(c11_code)) {
+        chaz_AtomicOps.has_c11_atomics = true;
+        chaz_ConfWriter_add_def("HAS_C11_ATOMICS", NULL);
+    }
+    if (chaz_CC_test_link(gnuc_atomic_code)) {
+        chaz_AtomicOps.has_gnuc_atomics = true;
+        chaz_ConfWriter_add_def("HAS_GNUC_ATOMIC_BUILTINS", NULL);
+    }
+    if (chaz_CC_test_link(gnuc_sync_code)) {
+        chaz_AtomicOps.has_gnuc_sync = true;
+        chaz_ConfWriter_add_def("HAS_GNUC_SYNC_BUILTINS", NULL);
+    }
+    if (chaz_CC_test_link(interlocked_code)) {
+        chaz_AtomicOps.has_interlocked = true;
+        chaz_ConfWriter_add_def("HAS_INTERLOCKED", NULL);
+    }
+}
+
+static void
+chaz_AtomicOps_probe_lock_free(void) {
+    static const char atomic64_code[] =
+        "static %s x;\n"
+        "int main() {\n"
+        "    %s y = 0;\n"
+        "    __atomic_fetch_add(&x, 1, __ATOMIC_SEQ_CST);\n"
+        "    __atomic_compare_exchange_n(&x, &y, y + 1, 0,\n"
+        "        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);\n"
+        "    return (int)__atomic_load_n(&x, __ATOMIC_SEQ_CST);\n"
+        "}\n";
+    static const char *int64_types[] = {
+        "long long",
+        "__int64",
+        NULL
+    };
+    char code_buf[sizeof(atomic64_code) + 100];
+    const char *includes = "";
+    const char *prefix   = NULL;
+    int i;
+
+    /* 8-byte atomics without libatomic. */
+    if (chaz_AtomicOps.has_gnuc_atomics) {
+        for (i = 0; int64_types[i] != NULL; i++) {
+            sprintf(code_buf, atomic64_code, int64_types[i], int64_types[i]);
+            if (chaz_CC_test_link(code_buf)) {
+                chaz_ConfWriter_add_def("HAS_ATOMIC64", NULL);
+                break;
+            }
+        }
+    }
+    else if (chaz_AtomicOps.has_interlocked) {
+        chaz_ConfWriter_add_def("HAS_ATOMIC64", NULL);
+    }
+
+    /* Lock-free properties, 0 meaning never, 1 sometimes and 2 always
+     * lock-free. */
+    if (chaz_AtomicOps.has_c11_atomics) {
+        includes = "#include <stdatomic.h>";
+        prefix   = "ATOMIC_";
+    }
+    else if (chaz_AtomicOps.has_gnuc_atomics) {
+        prefix   = "__GCC_ATOMIC_";
+    }
+    if (prefix) {
+        char *macro = chaz_Util_join("", prefix, "INT_LOCK_FREE", NULL);
+        chaz_AtomicOps_probe_lock_free_macro("LOCK_FREE_INT", macro,
+                                             includes);
+        free(macro);
+        macro = chaz_Util_join("", prefix, "LONG_LOCK_FREE", NULL);
+        chaz_AtomicOps_probe_lock_free_macro("LOCK_FREE_LONG", macro,
+                                             includes);
+        free(macro);
+        macro = chaz_Util_join("", prefix, "LLONG_LOCK_FREE", NULL);
+        chaz_AtomicOps_probe_lock_free_macro("LOCK_FREE_LLONG", macro,
+                                             includes);
+        free(macro);
+        macro = chaz_Util_join("", prefix, "POINTER_LOCK_FREE", NULL);
+        chaz_AtomicOps_probe_lock_free_macro("LOCK_FREE_POINTER", macro,
+                                             includes);
+        free(macro);
+    }
+}
 
+static void
+chaz_AtomicOps_probe_lock_free_macro(const char *sym, const char *macro,
+                                     const char *includes) {
+    static const char lock_free_code[] =
+        "%s\n"
+        "int a[(%s) == %d ? 1 : -1];\n";
+    char code_buf[sizeof(lock_free_code) + 100];
+    int value;
+
+    for (value = 2; value >= 0; value--) {
+        sprintf(code_buf, lock_free_code, includes, macro, value);
+        if (chaz_CC_test_compile(code_buf)) {
+            char value_buf[10];
+            sprintf(value_buf, "%d", value);
+            chaz_ConfWriter_add_def(sym, value_buf);
+            return;
+        }
+    }
+}
+
+static void
+chaz_AtomicOps_probe_cas128(void) {
+    static const char sync_cas128_code[] =
+        "static unsigned __int128 x;\n"
+        "int main() {\n"
+        "    unsigned __int128 y = 0;\n"
+        "    return !__sync_bool_compare_and_swap(&x, y, y + 1);\n"
+        "}\n";
+    static const char atomic_cas128_code[] =
+        "static unsigned __int128 x;\n"
+        "int main() {\n"
+        "    unsigned __int128 y = 0;\n"
+        "    return !__atomic_compare_exchange_n(&x, &y, y + 1, 0,\n"
+        "        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);\n"
+        "}\n";
+    static const char msvc_cas128_code[] =
+        "#include <intrin.h>\n"
+        "static __declspec(align(16)) __int64 x[2];\n"
+        "int main() {\n"
+        "    __int64 comparand[2] = { 0, 0 };\n"
+        "    return !_InterlockedCompareExchange128(x, 1, 1, comparand);\n"
+        "}\n";
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    const char *cflags  = NULL;
+    const char *ldflags = NULL;
+
+    if (chaz_CC_is_msvc()) {
+        if (chaz_CC_test_link(msvc_cas128_code)) {
+            cflags  = "";
+            ldflags = "";
+        }
+    }
+    else if (chaz_CC_is_gcc()) {
+        /* cmpxchg16b is only emitted inline for the __sync builtins and
+         * needs -mcx16 on x86-64.  Otherwise, libatomic provides the
+         * operation, usually lock-free at runtime. */
+        if (chaz_CC_test_link(sync_cas128_code)) {
+            cflags  = "";
+            ldflags = "";
+        }
+        if (!cflags) {
+            chaz_CFlags_append(temp_cflags, "-mcx16");
+            if (chaz_CC_test_link(sync_cas128_code)) {
+                cflags  = "-mcx16";
+                ldflags = "";
+            }
+            chaz_CFlags_clear(temp_cflags);
+        }
+        if (!cflags) {
+            chaz_CFlags_add_external_lib(temp_cflags, "atomic");
+            if (chaz_CC_test_link(atomic_cas128_code)) {
+                cflags  = "";
+                ldflags = chaz_CFlags_get_string(temp_cflags);
+            }
+        }
+    }
+
+    if (cflags) {
+        char *value = chaz_Util_join("", "\"", cflags, "\"", NULL);
+        chaz_ConfWriter_add_def("HAS_CAS128", NULL);
+        chaz_ConfWriter_add_def("CAS128_CFLAGS", value);
+        free(value);
+        value = chaz_Util_join("", "\"", ldflags, "\"", NULL);
+        chaz_ConfWriter_add_def("CAS128_LDFLAGS", value);
+        free(value);
+    }
+    chaz_CFlags_clear(temp_cflags);
+}
+
+static void
+chaz_AtomicOps_write_layer(void) {
+    static const char *const gnuc_atomic_layer[] = {
+        "#define CHY_ATOMIC(type) type\n",
+        "#define chy_atomic_load(ptr, order) __atomic_load_n(ptr, order)\n",
+        "#define chy_atomic_store(ptr, val, order) \\\n",
+        "    __atomic_store_n(ptr, val, order)\n",
+        "#define chy_atomic_cas(ptr, expected, desired, order) \\\n",
+        "    __atomic_compare_exchange_n(ptr, expected, desired, 0, \\\n",
+        "        order, CHY_ATOMIC_FAILURE_ORDER(order))\n",
+        "#define chy_atomic_fetch_add(ptr, val, order) \\\n",
+        "    __atomic_fetch_add(ptr, val, order)\n",
+        "#define chy_atomic_fence(order) __atomic_thread_fence(order)\n",
+        NULL
+    };
+    static const char *const c11_layer[] = {
+        "#include <stdatomic.h>\n",
+        "#define CHY_ATOMIC(type) _Atomic(type)\n",
+        "#define chy_atomic_load(ptr, order) \\\n",
+        "    atomic_load_explicit(ptr, order)\n",
+        "#define chy_atomic_store(ptr, val, order) \\\n",
+        "    atomic_store_explicit(ptr, val, order)\n",
+        "#define chy_atomic_cas(ptr, expected, desired, order) \\\n",
+        "    atomic_compare_exchange_strong_explicit(ptr, expected, \\\n",
+        "        desired, order, CHY_ATOMIC_FAILURE_ORDER(order))\n",
+        "#define chy_atomic_fetch_add(ptr, val, order) \\\n",
+        "    atomic_fetch_add_explicit(ptr, val, order)\n",
+        "#define chy_atomic_fence(order) atomic_thread_fence(order)\n",
+        NULL
+    };
+    /* Volatile accesses have acquire and release semantics with MSVC on
+     * x86 and x64, so only sequentially consistent stores need a fence. */
+    static const char *const interlocked_layer[] = {
+        "#include <intrin.h>\n",
+        "#define CHY_ATOMIC(type) type volatile\n",
+        "static __inline int\n",
+        "chy_atomic_cas32(volatile long *ptr, long *expected,\n",
+        "                 long desired) {\n",
+        "    long old\n",
+        "        = _InterlockedCompareExchange(ptr, desired, *expected);\n",
+        "    if (old == *expected) { return 1; }\n",
+        "    *expected = old;\n",
+        "    return 0;\n",
+        "}\n",
+        "static __inline int\n",
+        "chy_atomic_cas64(volatile __int64 *ptr, __int64 *expected,\n",
+        "                 __int64 desired) {\n",
+        "    __int64 old\n",
+        "        = _InterlockedCompareExchange64(ptr, desired, *expected);\n",
+        "    if (old == *expected) { return 1; }\n",
+        "    *expected = old;\n",
+        "    return 0;\n",
+        "}\n",
+        "#define chy_atomic_load(ptr, order) (*(ptr))\n",
+        "#define chy_atomic_store(ptr, val, order) \\\n",
+        "    ((order) == CHY_ATOMIC_ORDER_SEQ_CST \\\n",
+        "     ? (void)(*(ptr) = (val), _mm_mfence()) \\\n",
+        "     : (void)(*(ptr) = (val)))\n",
+        "#define chy_atomic_cas(ptr, expected, desired, order) \\\n",
+        "    (sizeof(*(ptr)) == 8 \\\n",
+        "     ? chy_atomic_cas64((volatile __int64*)(ptr), \\\n",
+        "                        (__int64*)(expected), \\\n",
+        "                        (__int64)(desired)) \\\n",
+        "     : chy_atomic_cas32((volatile long*)(ptr), \\\n",
+        "                        (long*)(expected), \\\n",
+        "                        (long)(__int64)(desired)))\n",
+        "#define chy_atomic_fetch_add(ptr, val, order) \\\n",
+        "    (sizeof(*(ptr)) == 8 \\\n",
+        "     ? _InterlockedExchangeAdd64((volatile __int64*)(ptr), \\\n",
+        "                                 (val)) \\\n",
+        "     : _InterlockedExchangeAdd((volatile long*)(ptr), \\\n",
+        "                               (long)(val)))\n",
+        "#define chy_atomic_fence(order) _mm_mfence()\n",
+        NULL
+    };
+    /* The __sync builtins are full barriers, so the memory order is
+     * ignored. */
+    static const char *const gnuc_sync_layer[] = {
+        "#define CHY_ATOMIC(type) type volatile\n",
+        "#define chy_atomic_load(ptr, order) \\\n",
+        "    __extension__ ({ __typeof__(*(ptr)) chy_val_ = *(ptr); \\\n",
+        "                     __sync_synchronize(); chy_val_; })\n",
+        "#define chy_atomic_store(ptr, val, order) \\\n",
+        "    (__sync_synchronize(), (void)(*(ptr) = (val)), \\\n",
+        "     __sync_synchronize())\n",
+        "#define chy_atomic_cas(ptr, expected, desired, order) \\\n",
+        "    __extension__ ({ __typeof__(*(ptr)) chy_old_ = *(expected); \\\n",
+        "                     __typeof__(*(ptr)) chy_prev_ \\\n",
+        "                         = __sync_val_compare_and_swap( \\\n",
+        "                               ptr, chy_old_, desired); \\\n",
+        "                     *(expected) = chy_prev_; \\\n",
+        "                     chy_prev_ == chy_old_; })\n",
+        "#define chy_atomic_fetch_add(ptr, val, order) \\\n",
+        "    __sync_fetch_and_add(ptr, val)\n",
+        "#define chy_atomic_fence(order) __sync_synchronize()\n",
+        NULL
+    };
+    static const char *const c11_orders[] = {
+        "memory_order_relaxed", "memory_order_acquire",
+        "memory_order_release", "memory_order_acq_rel",
+        "memory_order_seq_cst"
+    };
+    static const char *const gnuc_orders[] = {
+        "__ATOMIC_RELAXED", "__ATOMIC_ACQUIRE", "__ATOMIC_RELEASE",
+        "__ATOMIC_ACQ_REL", "__ATOMIC_SEQ_CST"
+    };
+    static const char *const plain_orders[] = {
+        "0", "2", "3", "4", "5"
+    };
+    static const char *const order_syms[] = {
+        "ATOMIC_ORDER_RELAXED", "ATOMIC_ORDER_ACQUIRE",
+        "ATOMIC_ORDER_RELEASE", "ATOMIC_ORDER_ACQ_REL",
+        "ATOMIC_ORDER_SEQ_CST"
+    };
+    const char *const *layer;
+    const char *const *orders;
+    const char *guard = "#ifdef CHY_EMPLOY_ATOMICOPS\n";
+    int i;
+
+    if (chaz_AtomicOps.has_gnuc_atomics) {
+        layer  = gnuc_atomic_layer;
+        orders = gnuc_orders;
+    }
+    else if (chaz_AtomicOps.has_c11_atomics) {
+        /* _Atomic isn't available in C++. */
+        layer  = c11_layer;
+        orders = c11_orders;
+        guard  = "#if (defined(CHY_EMPLOY_ATOMICOPS) "
+                 "&& !defined(__cplusplus))\n";
+    }
+    else if (chaz_AtomicOps.has_interlocked) {
+        layer  = interlocked_layer;
+        orders = plain_orders;
+    }
+    else if (chaz_AtomicOps.has_gnuc_sync) {
+        layer  = gnuc_sync_layer;
+        orders = plain_orders;
+    }
+    else {
+        return;
+    }
+
+    /* The layer pulls in system headers and static functions, so it's
+     * only written if requested. */
+    chaz_ConfWriter_append_conf("%s", guard);
+    chaz_ConfWriter_append_conf("#define CHY_HAS_ATOMIC_LAYER\n");
+    for (i = 0; i < 5; i++) {
+        chaz_ConfWriter_append_conf("#define CHY_%s %s\n", order_syms[i],
+                                    orders[i]);
+    }
+    chaz_ConfWriter_append_conf(
+        "#define CHY_ATOMIC_FAILURE_ORDER(order) \\\n"
+        "    ((order) == CHY_ATOMIC_ORDER_RELEASE \\\n"
+        "     ? CHY_ATOMIC_ORDER_RELAXED \\\n"
+        "     : (order) == CHY_ATOMIC_ORDER_ACQ_REL \\\n"
+        "     ? CHY_ATOMIC_ORDER_ACQUIRE \\\n"
+        "     : (order))\n");
+    for (i = 0; layer[i] != NULL; i++) {
+        chaz_ConfWriter_append_conf("%s", layer[i]);
+    }
+    chaz_ConfWriter_append_conf(
+        "#if defined(CHY_USE_SHORT_NAMES) || defined(CHAZ_USE_SHORT_NAMES)\n"
+        "  #define HAS_ATOMIC_LAYER CHY_HAS_ATOMIC_LAYER\n");
+    for (i = 0; i < 5; i++) {
+        chaz_ConfWriter_append_conf("  #define %s CHY_%s\n", order_syms[i],
+                                    order_syms[i]);
+    }
+    chaz_ConfWriter_append_conf("#endif\n"
+                                "#endif /* EMPLOY_ATOMICOPS */\n\n");
+}
 
@@ -38,6 +38,59 @@ extern "C" {
  * This symbol is defined if OSAtomicCompareAndSwapPtr is available:
  *
  * HAS_OSATOMIC_CAS_PTR
+ *
+ * These symbols are defined if atomic operations on words and pointers
+ * link without libatomic, using C11 atomics, the GCC __atomic builtins, the
+ * GCC __sync builtins or the MSVC Interlocked intrinsics:
+ *
+ * HAS_STDATOMIC_H
+ * HAS_C11_ATOMICS
+ * HAS_GNUC_ATOMIC_BUILTINS
+ * HAS_GNUC_SYNC_BUILTINS
+ * HAS_INTERLOCKED
+ *
+ * Defined if 8-byte atomic operations work without libatomic:
+ *
+ * HAS_ATOMIC64
+ *
+ * The lock-free properties of atomic types, taken from the C11 or GCC
+ * predefined macros: 0 for never, 1 for sometimes and 2 for always
+ * lock-free.
+ *
+ * LOCK_FREE_INT
+ * LOCK_FREE_LONG
+ * LOCK_FREE_LLONG
+ * LOCK_FREE_POINTER
+ *
+ * Defined if a 128-bit compare-and-swap is available, along with string
+ * literals containing the flags it needs, e.g. "-mcx16" or "-latomic":
+ *
+ * HAS_CAS128
+ * CAS128_CFLAGS
+ * CAS128_LDFLAGS
+ *
+ * If any backend is available and CHY_EMPLOY_ATOMICOPS is defined before
+ * charmony.h is included, HAS_ATOMIC_LAYER is defined along with the
+ * memory orders ATOMIC_ORDER_RELAXED, ATOMIC_ORDER_ACQUIRE,
+ * ATOMIC_ORDER_RELEASE, ATOMIC_ORDER_ACQ_REL and ATOMIC_ORDER_SEQ_CST,
+ * and the following macros, which are mapped to the fastest backend and
+ * have no short names.  The layer may include system headers and define
+ * static functions.  If the only backend is C11 atomics, it isn't
+ * available in C++.
+ *
+ *     #define CHY_EMPLOY_ATOMICOPS
+ *     #include "charmony.h"
+ *
+ *
+ * CHY_ATOMIC(type)                          Declare an atomic object.
+ * chy_atomic_load(ptr, order)
+ * chy_atomic_store(ptr, val, order)
+ * chy_atomic_cas(ptr, expected, desired, order)
+ * chy_atomic_fetch_add(ptr, val, order)
+ * chy_atomic_fence(order)
+ *
+ * chy_atomic_cas follows the C11 strong compare-exchange: `expected` points
+ * to the expected value, which is updated if the operation fails.
  */
 void chaz_AtomicOps_run(void);
 
@@ -0,0 +1,191 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Charmonizer/Probe/Attributes.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/Util.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char chaz_Attributes_func_code[] =
+    CHAZ_QUOTE(  static %s int f(int x) {        )
+    CHAZ_QUOTE(      return x + 1;               )
+    CHAZ_QUOTE(  }                               )
+    CHAZ_QUOTE(  int main() {                    )
+    CHAZ_QUOTE(      return f(-1);               )
+    CHAZ_QUOTE(  }                               );
+
+static const char chaz_Attributes_alloc_code[] =
+    CHAZ_QUOTE(  #include <stdlib.h>             )
+    CHAZ_QUOTE(  static %s void *f(size_t n) {   )
+    CHAZ_QUOTE(      return malloc(n);           )
+    CHAZ_QUOTE(  }                               )
+    CHAZ_QUOTE(  int main() {                    )
+    CHAZ_QUOTE(      void *p = f(16);            )
+    CHAZ_QUOTE(      free(p);                    )
+    CHAZ_QUOTE(      return 0;                   )
+    CHAZ_QUOTE(  }                               );
+
+static const char chaz_Attributes_var_code[] =
+    CHAZ_QUOTE(  static %s int x[4];             )
+    CHAZ_QUOTE(  int main() {                    )
+    CHAZ_QUOTE(      return x[0];                )
+    CHAZ_QUOTE(  }                               );
+
+static const char chaz_Attributes_restrict_code[] =
+    CHAZ_QUOTE(  static int f(int *%s a) {       )
+    CHAZ_QUOTE(      return *a;                  )
+    CHAZ_QUOTE(  }                               )
+    CHAZ_QUOTE(  int main() {                    )
+    CHAZ_QUOTE(      int x = 0;                  )
+    CHAZ_QUOTE(      return f(&x);               )
+    CHAZ_QUOTE(  }                               );
+
+/* A spelling to test and the corresponding macro value.  They only differ
+ * for macros with parameters.
+ */
+typedef struct chaz_Attributes_option {
+    const char *test;
+    const char *value;
+} chaz_Attributes_option;
+
+typedef struct chaz_Attributes_attr {
+    const char *sym;
+    const char *code;
+    int         has_fallback;
+    chaz_Attributes_option options[3];
+} chaz_Attributes_attr;
+
+static const chaz_Attributes_attr chaz_Attributes_attrs[] = {
+    {
+        "HOT", chaz_Attributes_func_code, true,
+        { { "__attribute__((hot))", "__attribute__((hot))" },
+          { NULL, NULL } }
+    },
+    {
+        "COLD", chaz_Attributes_func_code, true,
+        { { "__attribute__((cold))", "__attribute__((cold))" },
+          { NULL, NULL } }
+    },
+    {
+        "FORCE_INLINE", chaz_Attributes_func_code, true,
+        { { "__inline__ __attribute__((always_inline))",
+            "__inline__ __attribute__((always_inline))" },
+          { "__forceinline", "__forceinline" },
+          { NULL, NULL } }
+    },
+    {
+        "NOINLINE", chaz_Attributes_func_code, true,
+        { { "__attribute__((noinline))", "__attribute__((noinline))" },
+          { "__declspec(noinline)", "__declspec(noinline)" },
+          { NULL, NULL } }
+    },
+    {
+        "FLATTEN", chaz_Attributes_func_code, true,
+        { { "__attribute__((flatten))", "__attribute__((flatten))" },
+          { NULL, NULL } }
+    },
+    {
+        "PURE_FUNC", chaz_Attributes_func_code, true,
+        { { "__attribute__((pure))", "__attribute__((pure))" },
+          { NULL, NULL } }
+    },
+    {
+        "CONST_FUNC", chaz_Attributes_func_code, true,
+        { { "__attribute__((const))", "__attribute__((const))" },
+          { NULL, NULL } }
+    },
+    {
+        "MALLOC_FUNC", chaz_Attributes_alloc_code, true,
+        { { "__attribute__((malloc))", "__attribute__((malloc))" },
+          { "__declspec(restrict)", "__declspec(restrict)" },
+          { NULL, NULL } }
+    },
+    {
+        "ALLOC_SIZE(n)", chaz_Attributes_alloc_code, true,
+        { { "__attribute__((alloc_size(1)))",
+            "__attribute__((alloc_size(n)))" },
+          { NULL, NULL } }
+    },
+    {
+        "RETURNS_ALIGNED(n)", chaz_Attributes_alloc_code, true,
+        { { "__attribute__((assume_aligned(16)))",
+            "__attribute__((assume_aligned(n)))" },
+          { NULL, NULL } }
+    },
+    /* Prefer the extensions, which work in C++ as well, over the C99
+     * keyword. */
+    {
+        "RESTRICT", chaz_Attributes_restrict_code, true,
+        { { "__restrict__", "__restrict__" },
+          { "__restrict", "__restrict" },
+          { "restrict", "restrict" } }
+    },
+    {
+        "ALIGNED(n)", chaz_Attributes_var_code, false,
+        { { "__attribute__((aligned(16)))", "__attribute__((aligned(n)))" },
+          { "__declspec(align(16))", "__declspec(align(n))" },
+          { NULL, NULL } }
+    },
+    { NULL, NULL, false, { { NULL, NULL } } }
+};
+
+/* Return the macro value for the first working option or NULL.
+ */
+static const char*
+chaz_Attributes_probe_attr(const chaz_Attributes_attr *attr);
+
+void
+chaz_Attributes_run(void) {
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    int i;
+
+    chaz_ConfWriter_start_module("Attributes");
+    chaz_CFlags_set_warnings_as_errors(temp_cflags);
+
+    for (i = 0; chaz_Attributes_attrs[i].sym != NULL; i++) {
+        const chaz_Attributes_attr *attr = &chaz_Attributes_attrs[i];
+        const char *value = chaz_Attributes_probe_attr(attr);
+        if (value) {
+            chaz_ConfWriter_add_def(attr->sym, value);
+        }
+        else if (attr->has_fallback) {
+            chaz_ConfWriter_add_def(attr->sym, NULL);
+        }
+    }
+
+    chaz_CFlags_clear(temp_cflags);
+    chaz_ConfWriter_end_module();
+}
+
+static const char*
+chaz_Attributes_probe_attr(const chaz_Attributes_attr *attr) {
+    char code_buf[sizeof(chaz_Attributes_alloc_code) + 100];
+    int num_options = sizeof(attr->options) / sizeof(attr->options[0]);
+    int i;
+
+    for (i = 0; i < num_options && attr->options[i].test != NULL; i++) {
+        sprintf(code_buf, attr->code, attr->options[i].test);
+        if (chaz_CC_test_compile(code_buf)) {
+            return attr->options[i].value;
+        }
+    }
+
+    return NULL;
+}
+
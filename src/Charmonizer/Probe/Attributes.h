@@ -0,0 +1,60 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Probe/Attributes.h
+ */
+
+#ifndef H_CHAZ_ATTRIBUTES
+#define H_CHAZ_ATTRIBUTES
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The Attributes module probes for function and variable attributes which
+ * help the optimizer on hot paths.  Each spelling is checked with warnings
+ * treated as errors, because compilers usually only warn about attributes
+ * they don't know.
+ *
+ * These macros are always defined.  They expand to nothing if no working
+ * spelling was found.  Function attributes go between the storage class and
+ * the return type, e.g. "static CHY_HOT int foo(void)":
+ *
+ * HOT
+ * COLD
+ * FORCE_INLINE            Includes the inline keyword.
+ * NOINLINE
+ * FLATTEN
+ * PURE_FUNC
+ * CONST_FUNC
+ * MALLOC_FUNC
+ * ALLOC_SIZE(n)           n is the index of the size argument.
+ * RETURNS_ALIGNED(n)
+ * RESTRICT
+ *
+ * This macro is only defined if the compiler supports alignment of
+ * variables, as it can't be emulated:
+ *
+ * ALIGNED(n)
+ */
+void chaz_Attributes_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_ATTRIBUTES */
+
@@ -30,6 +30,9 @@ chaz_BuildEnv_run(void) {
     chaz_ConfWriter_add_def("CC", chaz_CC_get_cc());
     chaz_ConfWriter_add_def("CFLAGS", chaz_CC_get_cflags());
     chaz_ConfWriter_add_def("EXTRA_CFLAGS", extra_cflags_string);
+    if (chaz_CC_get_linker()) {
+        chaz_ConfWriter_add_def("LINKER", chaz_CC_get_linker());
+    }
 
     chaz_ConfWriter_end_module();
 }
@@ -24,6 +24,11 @@
  * CC - String representation of the C compiler executable.
  * CFLAGS - C compiler flags.
  * EXTRA_CFLAGS - Extra C compiler flags.
+ *
+ * The following symbol will be defined if a linker other than the default
+ * linker of the compiler driver was selected:
+ *
+ * LINKER - Name of the linker passed to -fuse-ld.
  */
 
 #ifndef H_CHAZ_BUILDENV
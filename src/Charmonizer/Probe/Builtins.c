@@ -0,0 +1,496 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Charmonizer/Probe/Builtins.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/Util.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Module vars. */
+static struct {
+    int   has_helpers;
+    int   has_u64;
+    char *code;
+    char *short_names;
+} chaz_Builtins = { 0, 0, NULL, NULL };
+
+/* Append includes or helper functions to the code which is only written
+ * if CHY_EMPLOY_BUILTINS is defined.
+ */
+static void
+chaz_Builtins_append(const char *code);
+
+/* Define a macro and its short name if CHY_EMPLOY_BUILTINS is defined.
+ */
+static void
+chaz_Builtins_add_macro(const char *sym, const char *value);
+
+/* Define the inline keyword and the 64-bit type used by the helper
+ * functions, once.
+ */
+static void
+chaz_Builtins_start_helpers(void);
+
+/* Probe for branch hints, prefetching, alignment hints and unreachable
+ * code markers.
+ */
+static void
+chaz_Builtins_probe_hints(void);
+
+/* Probe for population count.
+ */
+static void
+chaz_Builtins_probe_popcount(void);
+
+/* Probe for counting leading and trailing zeros.
+ */
+static void
+chaz_Builtins_probe_bit_scan(void);
+
+/* Probe for byte swaps.
+ */
+static void
+chaz_Builtins_probe_bswap(void);
+
+void
+chaz_Builtins_run(void) {
+    chaz_ConfWriter_start_module("Builtins");
+
+    chaz_Builtins.code        = chaz_Util_strdup("");
+    chaz_Builtins.short_names = chaz_Util_strdup("");
+
+    chaz_Builtins_probe_hints();
+    chaz_Builtins_probe_popcount();
+    chaz_Builtins_probe_bit_scan();
+    chaz_Builtins_probe_bswap();
+
+    /* Keep intrinsic headers and static functions out of charmony.h
+     * unless requested. */
+    chaz_ConfWriter_append_conf("#ifdef CHY_EMPLOY_BUILTINS\n%s",
+                                chaz_Builtins.code);
+    chaz_ConfWriter_append_conf("#if defined(CHY_USE_SHORT_NAMES) "
+                                "|| defined(CHAZ_USE_SHORT_NAMES)\n%s"
+                                "#endif\n",
+                                chaz_Builtins.short_names);
+    chaz_ConfWriter_append_conf("#endif /* EMPLOY_BUILTINS */\n\n");
+
+    free(chaz_Builtins.code);
+    free(chaz_Builtins.short_names);
+    chaz_Builtins.code        = NULL;
+    chaz_Builtins.short_names = NULL;
+
+    chaz_ConfWriter_end_module();
+}
+
+static void
+chaz_Builtins_append(const char *code) {
+    char *joined = chaz_Util_join("", chaz_Builtins.code, code, NULL);
+    free(chaz_Builtins.code);
+    chaz_Builtins.code = joined;
+}
+
+static void
+chaz_Builtins_add_macro(const char *sym, const char *value) {
+    char *def = chaz_Util_join("", "#define CHY_", sym, " ", value, "\n",
+                               NULL);
+    char *alias = chaz_Util_join("", "  #define ", sym, " CHY_", sym, "\n",
+                                 NULL);
+    char *joined = chaz_Util_join("", chaz_Builtins.short_names, alias,
+                                  NULL);
+    chaz_Builtins_append(def);
+    free(chaz_Builtins.short_names);
+    chaz_Builtins.short_names = joined;
+    free(alias);
+    free(def);
+}
+
+static void
+chaz_Builtins_start_helpers(void) {
+    static const char *inline_options[] = {
+        "__inline",
+        "__inline__",
+        "inline",
+        NULL
+    };
+    static const char *u64_options[] = {
+        "unsigned long long",
+        "unsigned __int64",
+        NULL
+    };
+    static const char inline_code[] = "static %s int f() { return 1; }";
+    static const char u64_code[] =
+        CHAZ_QUOTE(  int a[sizeof(%s) == 8 ? 1 : -1];  );
+    char code_buf[100];
+    const char *inline_keyword = "";
+    int i;
+
+    if (chaz_Builtins.has_helpers) {
+        return;
+    }
+    chaz_Builtins.has_helpers = true;
+
+    for (i = 0; inline_options[i] != NULL; i++) {
+        sprintf(code_buf, inline_code, inline_options[i]);
+        if (chaz_CC_test_compile(code_buf)) {
+            inline_keyword = inline_options[i];
+            break;
+        }
+    }
+    sprintf(code_buf, "#define CHY_BUILTINS_INLINE static %s\n",
+            inline_keyword);
+    chaz_Builtins_append(code_buf);
+
+    for (i = 0; u64_options[i] != NULL; i++) {
+        sprintf(code_buf, u64_code, u64_options[i]);
+        if (chaz_CC_test_compile(code_buf)) {
+            chaz_Builtins.has_u64 = true;
+            sprintf(code_buf, "#define CHY_BUILTINS_U64 %s\n",
+                    u64_options[i]);
+            chaz_Builtins_append(code_buf);
+            break;
+        }
+    }
+}
+
+static void
+chaz_Builtins_probe_hints(void) {
+    static const char expect_code[] =
+        CHAZ_QUOTE(  int main(int argc, char **argv) {           )
+        CHAZ_QUOTE(      (void)argv;                             )
+        CHAZ_QUOTE(      if (__builtin_expect(argc == 1, 1)) {   )
+        CHAZ_QUOTE(          return 0;                           )
+        CHAZ_QUOTE(      }                                       )
+        CHAZ_QUOTE(      return 1;                               )
+        CHAZ_QUOTE(  }                                           );
+    static const char prefetch_code[] =
+        CHAZ_QUOTE(  int main() {                                )
+        CHAZ_QUOTE(      int x = 0;                              )
+        CHAZ_QUOTE(      __builtin_prefetch(&x);                 )
+        CHAZ_QUOTE(      __builtin_prefetch(&x, 0, 3);           )
+        CHAZ_QUOTE(      return x;                               )
+        CHAZ_QUOTE(  }                                           );
+    static const char mm_prefetch_code[] =
+        CHAZ_QUOTE(  #include <xmmintrin.h>                          )
+        CHAZ_QUOTE(  int main() {                                    )
+        CHAZ_QUOTE(      int x = 0;                                  )
+        CHAZ_QUOTE(      _mm_prefetch((const char*)&x, _MM_HINT_T0); )
+        CHAZ_QUOTE(      return x;                                   )
+        CHAZ_QUOTE(  }                                               );
+    static const char assume_aligned_code[] =
+        CHAZ_QUOTE(  int main() {                                    )
+        CHAZ_QUOTE(      static int x[4];                            )
+        CHAZ_QUOTE(      int *p = (int*)__builtin_assume_aligned(x, 16); )
+        CHAZ_QUOTE(      return p[0];                                )
+        CHAZ_QUOTE(  }                                               );
+    static const char unreachable_code[] =
+        CHAZ_QUOTE(  int main(int argc, char **argv) {           )
+        CHAZ_QUOTE(      (void)argv;                             )
+        CHAZ_QUOTE(      if (argc > 0) {                         )
+        CHAZ_QUOTE(          return 0;                           )
+        CHAZ_QUOTE(      }                                       )
+        CHAZ_QUOTE(      %s;                                     )
+        CHAZ_QUOTE(      return 1;                               )
+        CHAZ_QUOTE(  }                                           );
+    char code_buf[sizeof(unreachable_code) + 100];
+
+    if (chaz_CC_test_link(expect_code)) {
+        chaz_ConfWriter_add_def("HAS_BUILTIN_EXPECT", NULL);
+        chaz_Builtins_add_macro("LIKELY(x)", "__builtin_expect(!!(x), 1)");
+        chaz_Builtins_add_macro("UNLIKELY(x)", "__builtin_expect(!!(x), 0)");
+    }
+    else {
+        chaz_Builtins_add_macro("LIKELY(x)", "(x)");
+        chaz_Builtins_add_macro("UNLIKELY(x)", "(x)");
+    }
+
+    if (chaz_CC_test_link(prefetch_code)) {
+        chaz_ConfWriter_add_def("HAS_BUILTIN_PREFETCH", NULL);
+        chaz_Builtins_add_macro("PREFETCH(addr)", "__builtin_prefetch(addr)");
+    }
+    else if (chaz_CC_test_link(mm_prefetch_code)) {
+        chaz_Builtins_append("#include <xmmintrin.h>\n");
+        chaz_ConfWriter_add_def("HAS_MM_PREFETCH", NULL);
+        chaz_Builtins_add_macro("PREFETCH(addr)",
+                                "_mm_prefetch((const char*)(addr), "
+                                "_MM_HINT_T0)");
+    }
+    else {
+        chaz_Builtins_add_macro("PREFETCH(addr)", "((void)(addr))");
+    }
+
+    if (chaz_CC_test_link(assume_aligned_code)) {
+        chaz_ConfWriter_add_def("HAS_BUILTIN_ASSUME_ALIGNED", NULL);
+        chaz_Builtins_add_macro("ASSUME_ALIGNED(ptr, n)",
+                                "__builtin_assume_aligned(ptr, n)");
+    }
+    else {
+        chaz_Builtins_add_macro("ASSUME_ALIGNED(ptr, n)", "((void*)(ptr))");
+    }
+
+    sprintf(code_buf, unreachable_code, "__builtin_unreachable()");
+    if (chaz_CC_test_link(code_buf)) {
+        chaz_ConfWriter_add_def("HAS_BUILTIN_UNREACHABLE", NULL);
+        chaz_Builtins_add_macro("UNREACHABLE()", "__builtin_unreachable()");
+        return;
+    }
+    sprintf(code_buf, unreachable_code, "__assume(0)");
+    if (chaz_CC_test_link(code_buf)) {
+        chaz_ConfWriter_add_def("HAS_ASSUME", NULL);
+        chaz_Builtins_add_macro("UNREACHABLE()", "__assume(0)");
+        return;
+    }
+    chaz_Builtins_add_macro("UNREACHABLE()", "((void)0)");
+}
+
+static void
+chaz_Builtins_probe_popcount(void) {
+    static const char popcount_code[] =
+        CHAZ_QUOTE(  int main() {                                    )
+        CHAZ_QUOTE(      unsigned x = 7;                             )
+        CHAZ_QUOTE(      unsigned long long y = 7;                   )
+        CHAZ_QUOTE(      return __builtin_popcount(x)                )
+        CHAZ_QUOTE(             + __builtin_popcountll(y) - 6;       )
+        CHAZ_QUOTE(  }                                               );
+    static const char popcnt_code[] =
+        CHAZ_QUOTE(  #include <intrin.h>                             )
+        CHAZ_QUOTE(  int main() {                                    )
+        CHAZ_QUOTE(      return (int)__popcnt(7u)                    )
+        CHAZ_QUOTE(             + (int)__popcnt64(7) - 6;            )
+        CHAZ_QUOTE(  }                                               );
+    static const char popcount32_fallback[] =
+        "CHY_BUILTINS_INLINE int\n"
+        "chy_builtins_popcount32(unsigned long x) {\n"
+        "    x &= 0xFFFFFFFFUL;\n"
+        "    x = x - ((x >> 1) & 0x55555555UL);\n"
+        "    x = (x & 0x33333333UL) + ((x >> 2) & 0x33333333UL);\n"
+        "    x = (x + (x >> 4)) & 0x0F0F0F0FUL;\n"
+        "    return (int)(((x * 0x01010101UL) & 0xFFFFFFFFUL) >> 24);\n"
+        "}\n";
+    static const char popcount64_fallback[] =
+        "CHY_BUILTINS_INLINE int\n"
+        "chy_builtins_popcount64(CHY_BUILTINS_U64 x) {\n"
+        "    unsigned long lo = (unsigned long)(x & 0xFFFFFFFFUL);\n"
+        "    unsigned long hi = (unsigned long)(x >> 32);\n"
+        "    return chy_builtins_popcount32(lo)\n"
+        "           + chy_builtins_popcount32(hi);\n"
+        "}\n";
+
+    if (chaz_CC_test_link(popcount_code)) {
+        chaz_ConfWriter_add_def("HAS_BUILTIN_POPCOUNT", NULL);
+        chaz_Builtins_add_macro("POPCOUNT32(x)", "__builtin_popcount(x)");
+        chaz_Builtins_add_macro("POPCOUNT64(x)", "__builtin_popcountll(x)");
+        return;
+    }
+
+    /* The POPCNT instruction isn't available on all CPUs which MSVC
+     * targets by default, but it is on all CPUs supporting AVX. */
+    if (chaz_CC_has_macro("__AVX__") && chaz_CC_test_link(popcnt_code)) {
+        chaz_Builtins_append("#include <intrin.h>\n");
+        chaz_ConfWriter_add_def("HAS_POPCNT", NULL);
+        chaz_Builtins_add_macro("POPCOUNT32(x)", "((int)__popcnt(x))");
+        chaz_Builtins_add_macro("POPCOUNT64(x)", "((int)__popcnt64(x))");
+        return;
+    }
+
+    /* Fallback. */
+    chaz_Builtins_start_helpers();
+    chaz_Builtins_append(popcount32_fallback);
+    chaz_Builtins_add_macro("POPCOUNT32(x)", "chy_builtins_popcount32(x)");
+    if (chaz_Builtins.has_u64) {
+        chaz_Builtins_append(popcount64_fallback);
+        chaz_Builtins_add_macro("POPCOUNT64(x)",
+                                "chy_builtins_popcount64(x)");
+    }
+}
+
+static void
+chaz_Builtins_probe_bit_scan(void) {
+    static const char clz_code[] =
+        CHAZ_QUOTE(  int main() {                                    )
+        CHAZ_QUOTE(      unsigned long long one = 1;                 )
+        CHAZ_QUOTE(      return __builtin_clz(1u) + __builtin_ctz(1u) )
+        CHAZ_QUOTE(             + __builtin_clzll(one)               )
+        CHAZ_QUOTE(             + __builtin_ctzll(one) - 94;         )
+        CHAZ_QUOTE(  }                                               );
+    static const char bit_scan_code[] =
+        CHAZ_QUOTE(  #include <intrin.h>                             )
+        CHAZ_QUOTE(  int main() {                                    )
+        CHAZ_QUOTE(      unsigned long i;                            )
+        CHAZ_QUOTE(      unsigned __int64 x = 8;                     )
+        CHAZ_QUOTE(      _BitScanForward(&i, 8ul);                   )
+        CHAZ_QUOTE(      _BitScanReverse(&i, 8ul);                   )
+        CHAZ_QUOTE(      _BitScanForward64(&i, x);                   )
+        CHAZ_QUOTE(      _BitScanReverse64(&i, x);                   )
+        CHAZ_QUOTE(      return (int)i - 3;                          )
+        CHAZ_QUOTE(  }                                               );
+    static const char bit_scan32[] =
+        "CHY_BUILTINS_INLINE int\n"
+        "chy_builtins_ctz32(unsigned long x) {\n"
+        "    unsigned long i;\n"
+        "    _BitScanForward(&i, x);\n"
+        "    return (int)i;\n"
+        "}\n"
+        "CHY_BUILTINS_INLINE int\n"
+        "chy_builtins_clz32(unsigned long x) {\n"
+        "    unsigned long i;\n"
+        "    _BitScanReverse(&i, x);\n"
+        "    return 31 - (int)i;\n"
+        "}\n";
+    static const char bit_scan64[] =
+        "CHY_BUILTINS_INLINE int\n"
+        "chy_builtins_ctz64(unsigned __int64 x) {\n"
+        "    unsigned long i;\n"
+        "    _BitScanForward64(&i, x);\n"
+        "    return (int)i;\n"
+        "}\n"
+        "CHY_BUILTINS_INLINE int\n"
+        "chy_builtins_clz64(unsigned __int64 x) {\n"
+        "    unsigned long i;\n"
+        "    _BitScanReverse64(&i, x);\n"
+        "    return 63 - (int)i;\n"
+        "}\n";
+    static const char fallback32[] =
+        "CHY_BUILTINS_INLINE int\n"
+        "chy_builtins_ctz32(unsigned long x) {\n"
+        "    int n = 0;\n"
+        "    while (!(x & 1UL) && n < 32) { x >>= 1; n++; }\n"
+        "    return n;\n"
+        "}\n"
+        "CHY_BUILTINS_INLINE int\n"
+        "chy_builtins_clz32(unsigned long x) {\n"
+        "    int n = 0;\n"
+        "    while (!(x & 0x80000000UL) && n < 32) { x <<= 1; n++; }\n"
+        "    return n;\n"
+        "}\n";
+    static const char fallback64[] =
+        "CHY_BUILTINS_INLINE int\n"
+        "chy_builtins_ctz64(CHY_BUILTINS_U64 x) {\n"
+        "    int n = 0;\n"
+        "    while (!(x & 1) && n < 64) { x >>= 1; n++; }\n"
+        "    return n;\n"
+        "}\n"
+        "CHY_BUILTINS_INLINE int\n"
+        "chy_builtins_clz64(CHY_BUILTINS_U64 x) {\n"
+        "    int n = 0;\n"
+        "    while (!(x & ((CHY_BUILTINS_U64)1 << 63)) && n < 64) {\n"
+        "        x <<= 1;\n"
+        "        n++;\n"
+        "    }\n"
+        "    return n;\n"
+        "}\n";
+    int has_64 = true;
+
+    if (chaz_CC_test_link(clz_code)) {
+        chaz_ConfWriter_add_def("HAS_BUILTIN_CLZ", NULL);
+        chaz_Builtins_add_macro("CLZ32(x)", "__builtin_clz(x)");
+        chaz_Builtins_add_macro("CTZ32(x)", "__builtin_ctz(x)");
+        chaz_Builtins_add_macro("CLZ64(x)", "__builtin_clzll(x)");
+        chaz_Builtins_add_macro("CTZ64(x)", "__builtin_ctzll(x)");
+        return;
+    }
+
+    chaz_Builtins_start_helpers();
+    if (chaz_CC_test_link(bit_scan_code)) {
+        chaz_Builtins_append("#include <intrin.h>\n");
+        chaz_Builtins_append(bit_scan32);
+        chaz_Builtins_append(bit_scan64);
+        chaz_ConfWriter_add_def("HAS_BITSCANFORWARD", NULL);
+    }
+    else {
+        chaz_Builtins_append(fallback32);
+        if (chaz_Builtins.has_u64) {
+            chaz_Builtins_append(fallback64);
+        }
+        else {
+            has_64 = false;
+        }
+    }
+    chaz_Builtins_add_macro("CLZ32(x)", "chy_builtins_clz32(x)");
+    chaz_Builtins_add_macro("CTZ32(x)", "chy_builtins_ctz32(x)");
+    if (has_64) {
+        chaz_Builtins_add_macro("CLZ64(x)", "chy_builtins_clz64(x)");
+        chaz_Builtins_add_macro("CTZ64(x)", "chy_builtins_ctz64(x)");
+    }
+}
+
+static void
+chaz_Builtins_probe_bswap(void) {
+    static const char bswap_code[] =
+        CHAZ_QUOTE(  int main() {                                    )
+        CHAZ_QUOTE(      unsigned long long x = 1;                   )
+        CHAZ_QUOTE(      x = __builtin_bswap64(x);                   )
+        CHAZ_QUOTE(      return (int)__builtin_bswap16(1)            )
+        CHAZ_QUOTE(             + (int)__builtin_bswap32(1u)         )
+        CHAZ_QUOTE(             + (int)(x >> 56) - 1;                )
+        CHAZ_QUOTE(  }                                               );
+    static const char byteswap_code[] =
+        CHAZ_QUOTE(  #include <stdlib.h>                             )
+        CHAZ_QUOTE(  int main() {                                    )
+        CHAZ_QUOTE(      return (int)_byteswap_ushort(1)             )
+        CHAZ_QUOTE(             + (int)_byteswap_ulong(1ul)          )
+        CHAZ_QUOTE(             + (int)_byteswap_uint64(1) - 256;    )
+        CHAZ_QUOTE(  }                                               );
+    static const char fallback32[] =
+        "CHY_BUILTINS_INLINE unsigned short\n"
+        "chy_builtins_bswap16(unsigned short x) {\n"
+        "    return (unsigned short)(((x & 0xFFu) << 8)\n"
+        "                            | ((x >> 8) & 0xFFu));\n"
+        "}\n"
+        "CHY_BUILTINS_INLINE unsigned long\n"
+        "chy_builtins_bswap32(unsigned long x) {\n"
+        "    return ((x & 0xFFUL) << 24) | ((x & 0xFF00UL) << 8)\n"
+        "           | ((x >> 8) & 0xFF00UL) | ((x >> 24) & 0xFFUL);\n"
+        "}\n";
+    static const char fallback64[] =
+        "CHY_BUILTINS_INLINE CHY_BUILTINS_U64\n"
+        "chy_builtins_bswap64(CHY_BUILTINS_U64 x) {\n"
+        "    CHY_BUILTINS_U64 lo = chy_builtins_bswap32((unsigned long)x);\n"
+        "    CHY_BUILTINS_U64 hi\n"
+        "        = chy_builtins_bswap32((unsigned long)(x >> 32));\n"
+        "    return (lo << 32) | hi;\n"
+        "}\n";
+
+    if (chaz_CC_test_link(bswap_code)) {
+        chaz_ConfWriter_add_def("HAS_BUILTIN_BSWAP", NULL);
+        chaz_Builtins_add_macro("BSWAP16(x)", "__builtin_bswap16(x)");
+        chaz_Builtins_add_macro("BSWAP32(x)", "__builtin_bswap32(x)");
+        chaz_Builtins_add_macro("BSWAP64(x)", "__builtin_bswap64(x)");
+        return;
+    }
+
+    if (chaz_CC_test_link(byteswap_code)) {
+        chaz_Builtins_append("#include <stdlib.h>\n");
+        chaz_ConfWriter_add_def("HAS_BYTESWAP_ULONG", NULL);
+        chaz_Builtins_add_macro("BSWAP16(x)", "_byteswap_ushort(x)");
+        chaz_Builtins_add_macro("BSWAP32(x)", "_byteswap_ulong(x)");
+        chaz_Builtins_add_macro("BSWAP64(x)", "_byteswap_uint64(x)");
+        return;
+    }
+
+    /* Fallback. */
+    chaz_Builtins_start_helpers();
+    chaz_Builtins_append(fallback32);
+    chaz_Builtins_add_macro("BSWAP16(x)", "chy_builtins_bswap16(x)");
+    chaz_Builtins_add_macro("BSWAP32(x)", "chy_builtins_bswap32(x)");
+    if (chaz_Builtins.has_u64) {
+        chaz_Builtins_append(fallback64);
+        chaz_Builtins_add_macro("BSWAP64(x)", "chy_builtins_bswap64(x)");
+    }
+}
+
@@ -0,0 +1,88 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Probe/Builtins.h
+ */
+
+#ifndef H_CHAZ_BUILTINS
+#define H_CHAZ_BUILTINS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The Builtins module probes for compiler builtins and intrinsics used in
+ * hot loops and defines uniform macros for them.  GCC-style builtins are
+ * preferred, followed by the MSVC intrinsics.  Otherwise, the macros fall
+ * back to a no-op or to portable inline functions.
+ *
+ * Defined if the associated GCC-style builtins are available:
+ *
+ * HAS_BUILTIN_EXPECT            __builtin_expect
+ * HAS_BUILTIN_PREFETCH          __builtin_prefetch
+ * HAS_BUILTIN_ASSUME_ALIGNED    __builtin_assume_aligned
+ * HAS_BUILTIN_UNREACHABLE       __builtin_unreachable
+ * HAS_BUILTIN_POPCOUNT          __builtin_popcount, __builtin_popcountll
+ * HAS_BUILTIN_CLZ               __builtin_clz, __builtin_ctz and the
+ *                               long long variants
+ * HAS_BUILTIN_BSWAP             __builtin_bswap16/32/64
+ *
+ * Defined if the associated MSVC intrinsics are available:
+ *
+ * HAS_MM_PREFETCH               _mm_prefetch
+ * HAS_ASSUME                    __assume
+ * HAS_POPCNT                    __popcnt, __popcnt64 (only if the POPCNT
+ *                               instruction is guaranteed by /arch:AVX)
+ * HAS_BITSCANFORWARD            _BitScanForward/Reverse and the 64-bit
+ *                               variants
+ * HAS_BYTESWAP_ULONG            _byteswap_ushort/ulong/uint64
+ *
+ * The following macros, along with the includes and inline functions they
+ * need, are only defined if CHY_EMPLOY_BUILTINS is defined before
+ * charmony.h is included:
+ *
+ *     #define CHY_EMPLOY_BUILTINS
+ *     #include "charmony.h"
+ *
+ * LIKELY(x)
+ * UNLIKELY(x)
+ * PREFETCH(addr)
+ * ASSUME_ALIGNED(ptr, n)
+ * UNREACHABLE()
+ * POPCOUNT32(x)
+ * CLZ32(x)
+ * CTZ32(x)
+ * BSWAP16(x)
+ * BSWAP32(x)
+ *
+ * These macros additionally require that the builtins are available or
+ * that the compiler has a 64-bit integer type for the fallbacks:
+ *
+ * POPCOUNT64(x)
+ * CLZ64(x)
+ * CTZ64(x)
+ * BSWAP64(x)
+ *
+ * The results of the CLZ and CTZ macros are undefined for zero.
+ */
+void chaz_Builtins_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_BUILTINS */
+
@@ -0,0 +1,204 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Charmonizer/Probe/CPUDispatch.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/Util.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Feature names used in the test programs, which differ between
+ * architectures.
+ */
+typedef struct chaz_CPUDispatch_arch {
+    const char *macro;
+    const char *cpu_feature;
+    const char *target;
+    const char *clones;
+} chaz_CPUDispatch_arch;
+
+/* Return the feature names for the target architecture or NULL if it isn't
+ * supported.
+ */
+static const chaz_CPUDispatch_arch*
+chaz_CPUDispatch_find_arch(void);
+
+/* Probe for __builtin_cpu_init and __builtin_cpu_supports.
+ */
+static void
+chaz_CPUDispatch_probe_cpu_supports(const chaz_CPUDispatch_arch *arch);
+
+/* Probe for the target and target_clones attributes.
+ */
+static void
+chaz_CPUDispatch_probe_target(const chaz_CPUDispatch_arch *arch);
+
+/* Probe for ifunc resolvers.
+ */
+static void
+chaz_CPUDispatch_probe_ifunc(void);
+
+/* Compile and run a test program with warnings treated as errors.  Return
+ * true if it printed "42".
+ */
+static int
+chaz_CPUDispatch_run_test(const char *code);
+
+void
+chaz_CPUDispatch_run(void) {
+    const chaz_CPUDispatch_arch *arch = chaz_CPUDispatch_find_arch();
+
+    chaz_ConfWriter_start_module("CPUDispatch");
+
+    chaz_CPUDispatch_probe_cpu_supports(arch);
+    if (arch) {
+        chaz_CPUDispatch_probe_target(arch);
+    }
+    chaz_CPUDispatch_probe_ifunc();
+
+    chaz_ConfWriter_end_module();
+}
+
+static const chaz_CPUDispatch_arch*
+chaz_CPUDispatch_find_arch(void) {
+    static const chaz_CPUDispatch_arch archs[] = {
+        { "__x86_64__",  "avx2", "avx2", "avx2,default" },
+        { "__i386__",    "avx2", "avx2", "avx2,default" },
+        { "__aarch64__", "sve",  "+sve", "sve,default"  },
+        { NULL, NULL, NULL, NULL }
+    };
+    int i;
+
+    for (i = 0; archs[i].macro != NULL; i++) {
+        if (chaz_CC_has_macro(archs[i].macro)) {
+            return &archs[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void
+chaz_CPUDispatch_probe_cpu_supports(const chaz_CPUDispatch_arch *arch) {
+    static const char cpu_supports_code[] =
+        CHAZ_QUOTE(  int main() {                                  )
+        CHAZ_QUOTE(      __builtin_cpu_init();                     )
+        CHAZ_QUOTE(      return __builtin_cpu_supports("%s") ? 0 : 1;  )
+        CHAZ_QUOTE(  }                                             );
+    char code_buf[sizeof(cpu_supports_code) + 100];
+
+    if (arch) {
+        sprintf(code_buf, cpu_supports_code, arch->cpu_feature);
+        if (chaz_CC_test_link(code_buf)) {
+            chaz_ConfWriter_add_def("HAS_BUILTIN_CPU_SUPPORTS", NULL);
+            chaz_ConfWriter_add_def("CPU_INIT()", "__builtin_cpu_init()");
+            chaz_ConfWriter_add_def("CPU_SUPPORTS(feature)",
+                                    "__builtin_cpu_supports(feature)");
+            return;
+        }
+    }
+
+    /* Fallback. */
+    chaz_ConfWriter_add_def("CPU_INIT()", "((void)0)");
+    chaz_ConfWriter_add_def("CPU_SUPPORTS(feature)", "0");
+}
+
+static void
+chaz_CPUDispatch_probe_target(const chaz_CPUDispatch_arch *arch) {
+    static const char target_code[] =
+        CHAZ_QUOTE(  static int __attribute__((target("%s")))   )
+        CHAZ_QUOTE(  twice(int x) {                             )
+        CHAZ_QUOTE(      return x * 2;                          )
+        CHAZ_QUOTE(  }                                          )
+        CHAZ_QUOTE(  int main() {                               )
+        CHAZ_QUOTE(      return twice(0);                       )
+        CHAZ_QUOTE(  }                                          );
+    static const char target_clones_code[] =
+        CHAZ_QUOTE(  #include <stdio.h>                             )
+        CHAZ_QUOTE(  int __attribute__((target_clones("%s")))       )
+        CHAZ_QUOTE(  twice(int x) {                                 )
+        CHAZ_QUOTE(      return x * 2;                              )
+        CHAZ_QUOTE(  }                                              )
+        CHAZ_QUOTE(  int main() {                                   )
+        CHAZ_QUOTE(      printf("%%d", twice(21));                  )
+        CHAZ_QUOTE(      return 0;                                  )
+        CHAZ_QUOTE(  }                                              );
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    char code_buf[sizeof(target_clones_code) + 100];
+
+    /* Unknown attributes only produce a warning. */
+    chaz_CFlags_set_warnings_as_errors(temp_cflags);
+    sprintf(code_buf, target_code, arch->target);
+    if (chaz_CC_test_compile(code_buf)) {
+        chaz_ConfWriter_add_def("HAS_TARGET_ATTRIBUTE", NULL);
+        chaz_ConfWriter_add_def("TARGET(isa)",
+                                "__attribute__((target(isa)))");
+    }
+    chaz_CFlags_clear(temp_cflags);
+
+    /* target_clones needs ifunc support from the dynamic linker. */
+    sprintf(code_buf, target_clones_code, arch->clones);
+    if (chaz_CPUDispatch_run_test(code_buf)) {
+        chaz_ConfWriter_add_def("HAS_TARGET_CLONES", NULL);
+        chaz_ConfWriter_add_def("TARGET_CLONES(isas)",
+                                "__attribute__((target_clones(isas)))");
+    }
+}
+
+static void
+chaz_CPUDispatch_probe_ifunc(void) {
+    static const char ifunc_code[] =
+        CHAZ_QUOTE(  #include <stdio.h>                                   )
+        CHAZ_QUOTE(  static int answer_impl(void) {                       )
+        CHAZ_QUOTE(      return 42;                                       )
+        CHAZ_QUOTE(  }                                                    )
+        CHAZ_QUOTE(  static int (*resolve_answer(void))(void) {           )
+        CHAZ_QUOTE(      return answer_impl;                              )
+        CHAZ_QUOTE(  }                                                    )
+        CHAZ_QUOTE(  int answer(void)                                     )
+        CHAZ_QUOTE(      __attribute__((ifunc("resolve_answer")));        )
+        CHAZ_QUOTE(  int main() {                                         )
+        CHAZ_QUOTE(      printf("%d", answer());                          )
+        CHAZ_QUOTE(      return 0;                                        )
+        CHAZ_QUOTE(  }                                                    );
+
+    if (chaz_CPUDispatch_run_test(ifunc_code)) {
+        chaz_ConfWriter_add_def("HAS_IFUNC", NULL);
+        chaz_ConfWriter_add_def("IFUNC(resolver)",
+                                "__attribute__((ifunc(resolver)))");
+    }
+}
+
+static int
+chaz_CPUDispatch_run_test(const char *code) {
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    char   *output = NULL;
+    size_t  output_len;
+    int     success = false;
+
+    chaz_CFlags_set_warnings_as_errors(temp_cflags);
+    output = chaz_CC_capture_output(code, &output_len);
+    if (output != NULL) {
+        success = strtol(output, NULL, 10) == 42;
+        free(output);
+    }
+    chaz_CFlags_clear(temp_cflags);
+
+    return success;
+}
+
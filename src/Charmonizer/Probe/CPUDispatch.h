@@ -0,0 +1,66 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Probe/CPUDispatch.h
+ */
+
+#ifndef H_CHAZ_CPUDISPATCH
+#define H_CHAZ_CPUDISPATCH
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The CPUDispatch module probes for the compiler features needed to select
+ * code paths for the running CPU from a single generic build.  Features
+ * which depend on the dynamic linker and the C library (target_clones and
+ * ifunc) are verified by running a test program, so they won't be detected
+ * when cross-compiling.
+ *
+ * Defined if __builtin_cpu_init and __builtin_cpu_supports are available:
+ *
+ * HAS_BUILTIN_CPU_SUPPORTS
+ *
+ * Defined if the target attribute, the target_clones attribute and ifunc
+ * resolvers work:
+ *
+ * HAS_TARGET_ATTRIBUTE
+ * HAS_TARGET_CLONES
+ * HAS_IFUNC
+ *
+ * These macros are always defined.  Without __builtin_cpu_supports,
+ * CPU_INIT() does nothing and CPU_SUPPORTS(feature) is always 0, so that
+ * callers fall back to their generic code:
+ *
+ * CPU_INIT()
+ * CPU_SUPPORTS(feature)
+ *
+ * These macros are only defined if the associated feature is available.
+ * Their argument is a string literal, e.g. TARGET("avx2") or
+ * TARGET_CLONES("avx2,default"):
+ *
+ * TARGET(isa)
+ * TARGET_CLONES(isas)
+ * IFUNC(resolver)
+ */
+void chaz_CPUDispatch_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_CPUDISPATCH */
+
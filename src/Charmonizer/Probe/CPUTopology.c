@@ -0,0 +1,303 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Charmonizer/Probe/CPUTopology.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/HeaderChecker.h"
+#include "Charmonizer/Core/Util.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHAZ_CPUTOPOLOGY_DEFAULT_CACHE_LINE_SIZE 128
+#define CHAZ_CPUTOPOLOGY_DEFAULT_PAGE_SIZE       4096
+
+static const char chaz_CPUTopology_sysconf_line_code[] =
+    CHAZ_QUOTE(  #define _GNU_SOURCE                                   )
+    CHAZ_QUOTE(  #include <stdio.h>                                    )
+    CHAZ_QUOTE(  #include <unistd.h>                                   )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      long size = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);  )
+    CHAZ_QUOTE(      printf("%ld", size);                              )
+    CHAZ_QUOTE(      return 0;                                         )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_sysfs_line_code[] =
+    CHAZ_QUOTE(  #include <stdio.h>                                    )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      const char *path = "/sys/devices/system/cpu/cpu0" )
+    CHAZ_QUOTE(          "/cache/index0/coherency_line_size";          )
+    CHAZ_QUOTE(      long size = 0;                                    )
+    CHAZ_QUOTE(      FILE *file = fopen(path, "r");                    )
+    CHAZ_QUOTE(      if (file == NULL) { return 1; }                   )
+    CHAZ_QUOTE(      if (fscanf(file, "%ld", &size) != 1) { size = 0; })
+    CHAZ_QUOTE(      fclose(file);                                     )
+    CHAZ_QUOTE(      printf("%ld", size);                              )
+    CHAZ_QUOTE(      return 0;                                         )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_sysctl_line_code[] =
+    CHAZ_QUOTE(  #include <stdio.h>                                    )
+    CHAZ_QUOTE(  #include <sys/types.h>                                )
+    CHAZ_QUOTE(  #include <sys/sysctl.h>                               )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      long long size = 0;                               )
+    CHAZ_QUOTE(      size_t len = sizeof(size);                        )
+    CHAZ_QUOTE(      const char *name = "hw.cachelinesize";            )
+    CHAZ_QUOTE(      if (sysctlbyname(name, &size, &len, NULL, 0)) {   )
+    CHAZ_QUOTE(          return 1;                                     )
+    CHAZ_QUOTE(      }                                                 )
+    CHAZ_QUOTE(      printf("%ld", (long)size);                        )
+    CHAZ_QUOTE(      return 0;                                         )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_windows_line_code[] =
+    CHAZ_QUOTE(  #include <windows.h>                                  )
+    CHAZ_QUOTE(  #include <stdio.h>                                    )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      SYSTEM_LOGICAL_PROCESSOR_INFORMATION buf[256];    )
+    CHAZ_QUOTE(      DWORD len = sizeof(buf);                          )
+    CHAZ_QUOTE(      DWORD i;                                          )
+    CHAZ_QUOTE(      if (!GetLogicalProcessorInformation(buf, &len)) { )
+    CHAZ_QUOTE(          return 1;                                     )
+    CHAZ_QUOTE(      }                                                 )
+    CHAZ_QUOTE(      for (i = 0; i < len / sizeof(buf[0]); i++) {      )
+    CHAZ_QUOTE(          if (buf[i].Relationship != RelationCache) {   )
+    CHAZ_QUOTE(              continue;                                 )
+    CHAZ_QUOTE(          }                                             )
+    CHAZ_QUOTE(          if (buf[i].Cache.Level != 1) { continue; }    )
+    CHAZ_QUOTE(          printf("%u", (unsigned)buf[i].Cache.LineSize);)
+    CHAZ_QUOTE(          return 0;                                     )
+    CHAZ_QUOTE(      }                                                 )
+    CHAZ_QUOTE(      return 1;                                         )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_sysconf_page_code[] =
+    CHAZ_QUOTE(  #include <stdio.h>                                    )
+    CHAZ_QUOTE(  #include <unistd.h>                                   )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      printf("%ld", (long)sysconf(_SC_PAGESIZE));       )
+    CHAZ_QUOTE(      return 0;                                         )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_windows_page_code[] =
+    CHAZ_QUOTE(  #include <windows.h>                                  )
+    CHAZ_QUOTE(  #include <stdio.h>                                    )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      SYSTEM_INFO info;                                 )
+    CHAZ_QUOTE(      GetSystemInfo(&info);                             )
+    CHAZ_QUOTE(      printf("%lu", (unsigned long)info.dwPageSize);    )
+    CHAZ_QUOTE(      return 0;                                         )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_sysconf_cpus_code[] =
+    CHAZ_QUOTE(  #include <stdio.h>                                    )
+    CHAZ_QUOTE(  #include <unistd.h>                                   )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      long n = sysconf(_SC_NPROCESSORS_ONLN);           )
+    CHAZ_QUOTE(      printf("%ld", n);                                 )
+    CHAZ_QUOTE(      return 0;                                         )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_windows_cpus_code[] =
+    CHAZ_QUOTE(  #include <windows.h>                                  )
+    CHAZ_QUOTE(  #include <stdio.h>                                    )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      SYSTEM_INFO info;                                 )
+    CHAZ_QUOTE(      unsigned long n;                                  )
+    CHAZ_QUOTE(      GetSystemInfo(&info);                             )
+    CHAZ_QUOTE(      n = (unsigned long)info.dwNumberOfProcessors;     )
+    CHAZ_QUOTE(      printf("%lu", n);                                 )
+    CHAZ_QUOTE(      return 0;                                         )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_libnuma_code[] =
+    CHAZ_QUOTE(  #include <numa.h>                                     )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      return numa_available() < 0 ? 0 : 0;              )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_mbind_code[] =
+    CHAZ_QUOTE(  #include <numaif.h>                                   )
+    CHAZ_QUOTE(  static char buf[8192];                                )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      return (int)mbind(buf, 4096, MPOL_DEFAULT, 0, 0, 0);)
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_set_mempolicy_code[] =
+    CHAZ_QUOTE(  #include <numaif.h>                                   )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      return (int)set_mempolicy(MPOL_DEFAULT, 0, 0);    )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_CPUTopology_macro_value_code[] =
+    CHAZ_QUOTE(  int chaz_check[(%s) == %d ? 1 : -1];                  )
+    CHAZ_QUOTE(  int main() { return 0; }                              );
+
+/* Run each program in `sources` until one prints a positive number,
+ * optionally restricted to powers of two.  Return 0 if no program works.
+ */
+static long
+chaz_CPUTopology_query(const char **sources, int power_of_two);
+
+/* Determine the value of the compile-time power-of-two constant `macro`
+ * without running a program.  Return 0 if it's undefined or out of range.
+ */
+static long
+chaz_CPUTopology_macro_value(const char *macro);
+
+/* Define `sym` as the integer `value`.
+ */
+static void
+chaz_CPUTopology_define_long(const char *sym, long value);
+
+static void
+chaz_CPUTopology_probe_numa(void);
+
+void
+chaz_CPUTopology_run(void) {
+    const char *line_sources[5];
+    const char *page_sources[3];
+    const char *cpus_sources[3];
+    long line_size;
+    long page_size;
+    long num_cpus;
+
+    line_sources[0] = chaz_CPUTopology_sysconf_line_code;
+    line_sources[1] = chaz_CPUTopology_sysfs_line_code;
+    line_sources[2] = chaz_CPUTopology_sysctl_line_code;
+    line_sources[3] = chaz_CPUTopology_windows_line_code;
+    line_sources[4] = NULL;
+    page_sources[0] = chaz_CPUTopology_sysconf_page_code;
+    page_sources[1] = chaz_CPUTopology_windows_page_code;
+    page_sources[2] = NULL;
+    cpus_sources[0] = chaz_CPUTopology_sysconf_cpus_code;
+    cpus_sources[1] = chaz_CPUTopology_windows_cpus_code;
+    cpus_sources[2] = NULL;
+
+    chaz_ConfWriter_start_module("CPUTopology");
+
+    line_size = chaz_CPUTopology_query(line_sources, 1);
+    page_size = chaz_CPUTopology_query(page_sources, 1);
+    num_cpus  = chaz_CPUTopology_query(cpus_sources, 0);
+
+    if (line_size && page_size && num_cpus) {
+        chaz_ConfWriter_add_def("HOST_TOPOLOGY_DETECTED", NULL);
+    }
+    if (!line_size) {
+        line_size = chaz_CPUTopology_macro_value("__GCC_DESTRUCTIVE_SIZE");
+    }
+    if (!line_size) {
+        line_size = CHAZ_CPUTOPOLOGY_DEFAULT_CACHE_LINE_SIZE;
+    }
+    if (!page_size) {
+        page_size = CHAZ_CPUTOPOLOGY_DEFAULT_PAGE_SIZE;
+    }
+    if (!num_cpus) {
+        num_cpus = 1;
+    }
+    chaz_CPUTopology_define_long("L1_CACHE_LINE_SIZE", line_size);
+    chaz_CPUTopology_define_long("HOST_PAGE_SIZE", page_size);
+    chaz_CPUTopology_define_long("HOST_NUM_CPUS", num_cpus);
+
+    chaz_CPUTopology_probe_numa();
+
+    chaz_ConfWriter_end_module();
+}
+
+static long
+chaz_CPUTopology_query(const char **sources, int power_of_two) {
+    int i;
+
+    for (i = 0; sources[i] != NULL; i++) {
+        size_t output_len;
+        char *output = chaz_CC_capture_output(sources[i], &output_len);
+        long value = 0;
+
+        if (output != NULL) {
+            value = strtol(output, NULL, 10);
+            free(output);
+        }
+        if (value <= 0) { continue; }
+        if (power_of_two && (value & (value - 1)) != 0) { continue; }
+
+        return value;
+    }
+
+    return 0;
+}
+
+static long
+chaz_CPUTopology_macro_value(const char *macro) {
+    char code_buf[sizeof(chaz_CPUTopology_macro_value_code) + 100];
+    long value;
+
+    if (!chaz_CC_has_macro(macro)) { return 0; }
+
+    for (value = 16; value <= 1024; value *= 2) {
+        sprintf(code_buf, chaz_CPUTopology_macro_value_code, macro,
+                (int)value);
+        if (chaz_CC_test_compile(code_buf)) {
+            return value;
+        }
+    }
+
+    return 0;
+}
+
+static void
+chaz_CPUTopology_define_long(const char *sym, long value) {
+    char buf[30];
+    sprintf(buf, "%ld", value);
+    chaz_ConfWriter_add_def(sym, buf);
+}
+
+static void
+chaz_CPUTopology_probe_numa(void) {
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    int has_libnuma = 0;
+
+    if (chaz_HeadCheck_check_header("numa.h")) {
+        chaz_ConfWriter_add_def("HAS_NUMA_H", NULL);
+
+        chaz_CFlags_add_external_lib(temp_cflags, "numa");
+        has_libnuma = chaz_CC_test_link(chaz_CPUTopology_libnuma_code);
+        if (has_libnuma) {
+            char *value = chaz_Util_join("", "\"",
+                                         chaz_CFlags_get_string(temp_cflags),
+                                         "\"", NULL);
+            chaz_ConfWriter_add_def("HAS_LIBNUMA", NULL);
+            chaz_ConfWriter_add_def("NUMA_LDFLAGS", value);
+            free(value);
+        }
+        else {
+            chaz_CFlags_clear(temp_cflags);
+        }
+    }
+
+    /* mbind and set_mempolicy are declared in numaif.h and provided by
+     * libnuma. */
+    if (chaz_CC_test_link(chaz_CPUTopology_mbind_code)) {
+        chaz_ConfWriter_add_def("HAS_MBIND", NULL);
+    }
+    if (chaz_CC_test_link(chaz_CPUTopology_set_mempolicy_code)) {
+        chaz_ConfWriter_add_def("HAS_SET_MEMPOLICY", NULL);
+    }
+
+    chaz_CFlags_clear(temp_cflags);
+}
+
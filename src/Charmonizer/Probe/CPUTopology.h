@@ -0,0 +1,67 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Probe/CPUTopology.h
+ */
+
+#ifndef H_CHAZ_CPUTOPOLOGY
+#define H_CHAZ_CPUTOPOLOGY
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The CPUTopology module reports cache and memory parameters for padding
+ * and sizing concurrent data structures.
+ *
+ * The cache line size, page size and number of online CPUs of the build
+ * host are queried by running test programs using sysconf, sysfs,
+ * sysctlbyname or the Windows API.  If the programs can't be run, for
+ * example when cross-compiling, the cache line size is taken from the
+ * compiler's __GCC_DESTRUCTIVE_SIZE if available.  Otherwise, conservative
+ * defaults are used: 128 bytes for cache lines, which is correct for
+ * Apple M-series and POWER and avoids false sharing on x86 with adjacent
+ * line prefetching, 4096 bytes for pages, and 1 CPU.
+ *
+ * These symbols will always be defined:
+ *
+ * L1_CACHE_LINE_SIZE
+ * HOST_PAGE_SIZE
+ * HOST_NUM_CPUS
+ *
+ * Defined if the values above were queried from the build host rather
+ * than derived from defaults:
+ *
+ * HOST_TOPOLOGY_DETECTED
+ *
+ * These symbols will be defined if the associated NUMA facility is
+ * available.  NUMA_LDFLAGS is a string literal containing the flags needed
+ * to link against libnuma:
+ *
+ * HAS_NUMA_H
+ * HAS_LIBNUMA
+ * NUMA_LDFLAGS
+ * HAS_MBIND                <numaif.h>
+ * HAS_SET_MEMPOLICY        <numaif.h>
+ */
+void chaz_CPUTopology_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_CPUTOPOLOGY */
+
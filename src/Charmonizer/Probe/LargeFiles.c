@@ -72,6 +72,19 @@ chaz_LargeFiles_probe_lseek(chaz_LargeFiles_unbuff_combo *combo);
 static int
 chaz_LargeFiles_probe_pread64(chaz_LargeFiles_unbuff_combo *combo);
 
+/* Zero-copy, vectored, preallocation and cache control primitives.
+ */
+typedef struct chaz_LargeFiles_fast_io {
+    const char *sym;
+    const char *includes;
+    const char *body;
+} chaz_LargeFiles_fast_io;
+
+/* Probe for faster i/o primitives.
+ */
+static void
+chaz_LargeFiles_probe_fast_io(void);
+
 void
 chaz_LargeFiles_run(void) {
     int found_off64_t = false;
@@ -94,6 +107,8 @@ chaz_LargeFiles_run(void) {
         chaz_LargeFiles_probe_unbuff();
     }
 
+    chaz_LargeFiles_probe_fast_io();
+
     /* Make checks needed for testing. */
     if (chaz_HeadCheck_check_header("sys/stat.h")) {
         chaz_ConfWriter_append_conf("#define CHAZ_HAS_SYS_STAT_H\n");
@@ -258,3 +273,138 @@ chaz_LargeFiles_probe_unbuff(void) {
     }
 }
 
+static void
+chaz_LargeFiles_probe_fast_io(void) {
+    static const char fast_io_code[] =
+        "#define _GNU_SOURCE\n"
+        "#include <sys/types.h>\n"
+        "%s"
+        "int main() {\n"
+        "    int fd = 0;\n"
+        "%s"
+        "    return fd;\n"
+        "}\n";
+    static const char iovec_decl[] =
+        "    struct iovec iov;\n"
+        "    char buf[1];\n"
+        "    iov.iov_base = buf;\n"
+        "    iov.iov_len  = 1;\n";
+    static const chaz_LargeFiles_fast_io fast_io[] = {
+        {
+            "HAS_SENDFILE",
+            "#include <sys/sendfile.h>\n",
+            "    off_t offset = 0;\n"
+            "    sendfile(fd, fd, &offset, 1);\n"
+        },
+        {
+            "HAS_SPLICE",
+            "#include <fcntl.h>\n",
+            "    splice(fd, 0, fd, 0, 1, SPLICE_F_MOVE);\n"
+        },
+        {
+            "HAS_VMSPLICE",
+            "#include <fcntl.h>\n#include <sys/uio.h>\n",
+            "%s    vmsplice(fd, &iov, 1, SPLICE_F_GIFT);\n"
+        },
+        {
+            "HAS_COPY_FILE_RANGE",
+            "#include <unistd.h>\n",
+            "    copy_file_range(fd, 0, fd, 0, 1, 0);\n"
+        },
+        {
+            "HAS_POSIX_FALLOCATE",
+            "#include <fcntl.h>\n",
+            "    posix_fallocate(fd, 0, 4096);\n"
+        },
+        {
+            "HAS_FALLOCATE",
+            "#include <fcntl.h>\n",
+            "    fallocate(fd, 0, 0, 4096);\n"
+        },
+        {
+            "HAS_PREADV",
+            "#include <sys/uio.h>\n",
+            "%s    preadv(fd, &iov, 1, 0);\n"
+        },
+        {
+            "HAS_PWRITEV",
+            "#include <sys/uio.h>\n",
+            "%s    pwritev(fd, &iov, 1, 0);\n"
+        },
+        {
+            "HAS_PREADV2",
+            "#include <sys/uio.h>\n",
+            "%s    preadv2(fd, &iov, 1, 0, 0);\n"
+            "    pwritev2(fd, &iov, 1, 0, 0);\n"
+        },
+        {
+            "HAS_RWF_HIPRI",
+            "#include <sys/uio.h>\n",
+            "    fd = RWF_HIPRI;\n"
+        },
+        {
+            "HAS_RWF_DSYNC",
+            "#include <sys/uio.h>\n",
+            "    fd = RWF_DSYNC;\n"
+        },
+        {
+            "HAS_RWF_NOWAIT",
+            "#include <sys/uio.h>\n",
+            "    fd = RWF_NOWAIT;\n"
+        },
+        {
+            "HAS_O_DIRECT",
+            "#include <fcntl.h>\n",
+            "    fd = open(\"_charm_o_direct\", O_RDONLY | O_DIRECT);\n"
+        },
+        {
+            "HAS_STATX_DIOALIGN",
+            "#include <fcntl.h>\n#include <sys/stat.h>\n",
+            "    struct statx stx;\n"
+            "    statx(fd, \"\", AT_EMPTY_PATH, STATX_DIOALIGN, &stx);\n"
+            "    fd = (int)stx.stx_dio_mem_align;\n"
+        },
+        {
+            "HAS_O_NOATIME",
+            "#include <fcntl.h>\n",
+            "    fd = open(\"_charm_o_noatime\", O_RDONLY | O_NOATIME);\n"
+        },
+        {
+            "HAS_FDATASYNC",
+            "#include <unistd.h>\n",
+            "    fdatasync(fd);\n"
+        },
+        {
+            "HAS_SYNC_FILE_RANGE",
+            "#include <fcntl.h>\n",
+            "    sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);\n"
+        },
+        {
+            "HAS_F_NOCACHE",
+            "#include <fcntl.h>\n",
+            "    fcntl(fd, F_NOCACHE, 1);\n"
+        },
+        { NULL, NULL, NULL }
+    };
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    char body_buf[300];
+    char code_buf[sizeof(fast_io_code) + 400];
+    int i;
+
+    /* Without a prototype, the implicitly declared functions return int,
+     * which only triggers a warning. */
+    chaz_CFlags_set_warnings_as_errors(temp_cflags);
+    for (i = 0; fast_io[i].sym != NULL; i++) {
+        sprintf(body_buf, fast_io[i].body, iovec_decl);
+        sprintf(code_buf, fast_io_code, fast_io[i].includes, body_buf);
+        if (chaz_CC_test_link(code_buf)) {
+            chaz_ConfWriter_add_def(fast_io[i].sym, NULL);
+            if (strcmp(fast_io[i].sym, "HAS_O_DIRECT") == 0) {
+                /* Satisfies devices with logical blocks of up to 4 KB. */
+                chaz_ConfWriter_add_def("O_DIRECT_ALIGNMENT", "4096");
+            }
+        }
+    }
+    chaz_CFlags_clear(temp_cflags);
+}
+
@@ -52,6 +52,36 @@ extern "C" {
  * HAS_64BIT_LSEEK
  *
  * Use of the off64_t symbol may require sys/types.h.
+ *
+ * These symbols will be defined if the associated i/o primitive is
+ * available.  Most of them are Linux-specific and only declared if
+ * _GNU_SOURCE is defined before including any system header:
+ *
+ * HAS_SENDFILE            <sys/sendfile.h>
+ * HAS_SPLICE              <fcntl.h>
+ * HAS_VMSPLICE            <fcntl.h>
+ * HAS_COPY_FILE_RANGE     <unistd.h>
+ * HAS_POSIX_FALLOCATE     <fcntl.h>
+ * HAS_FALLOCATE           <fcntl.h>
+ * HAS_PREADV              <sys/uio.h>
+ * HAS_PWRITEV             <sys/uio.h>
+ * HAS_PREADV2             <sys/uio.h>, also pwritev2
+ * HAS_RWF_HIPRI           <sys/uio.h>
+ * HAS_RWF_DSYNC           <sys/uio.h>
+ * HAS_RWF_NOWAIT          <sys/uio.h>
+ * HAS_O_DIRECT            <fcntl.h>
+ * HAS_STATX_DIOALIGN      <sys/stat.h>
+ * HAS_O_NOATIME           <fcntl.h>
+ * HAS_FDATASYNC           <unistd.h>
+ * HAS_SYNC_FILE_RANGE     <fcntl.h>
+ * HAS_F_NOCACHE           <fcntl.h>, macOS
+ *
+ * If O_DIRECT is available, the following symbol holds an alignment for
+ * buffers, offsets and lengths which satisfies devices with logical
+ * blocks of up to 4 KB.  The exact requirements of a file can be queried
+ * with statx and STATX_DIOALIGN:
+ *
+ * O_DIRECT_ALIGNMENT
  */
 void chaz_LargeFiles_run(void);
 
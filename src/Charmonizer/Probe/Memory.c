@@ -27,11 +27,37 @@
 static void
 chaz_Memory_probe_alloca(void);
 
+/* Probe for aligned allocation functions and write chy_aligned_alloc and
+ * chy_aligned_free. */
+static void
+chaz_Memory_probe_aligned_alloc(void);
+
+/* Write the macros in `lines` mapping chy_aligned_alloc and
+ * chy_aligned_free to a library function. */
+static void
+chaz_Memory_write_macros(const char *const *lines);
+
+/* Write CHY_MEMORY_INLINE followed by the helper functions in `lines`,
+ * guarded by CHY_EMPLOY_ALIGNED_ALLOC. */
+static void
+chaz_Memory_write_helpers(const char *const *lines);
+
+/* Probe for mmap flags, madvise advice and mlock. */
+static void
+chaz_Memory_probe_mman(void);
+
+/* Probe for large page support in VirtualAlloc. */
+static void
+chaz_Memory_probe_virtual_alloc(void);
+
 void
 chaz_Memory_run(void) {
     chaz_ConfWriter_start_module("Memory");
 
     chaz_Memory_probe_alloca();
+    chaz_Memory_probe_aligned_alloc();
+    chaz_Memory_probe_mman();
+    chaz_Memory_probe_virtual_alloc();
 
     chaz_ConfWriter_end_module();
 }
@@ -105,4 +131,253 @@ chaz_Memory_probe_alloca(void) {
     chaz_CFlags_clear(temp_cflags);
 }
 
+static void
+chaz_Memory_write_macros(const char *const *lines) {
+    int i;
+
+    for (i = 0; lines[i] != NULL; i++) {
+        chaz_ConfWriter_append_conf("%s", lines[i]);
+    }
+    chaz_ConfWriter_append_conf("\n");
+}
+
+static void
+chaz_Memory_write_helpers(const char *const *lines) {
+    static const char *inline_options[] = {
+        "__inline",
+        "__inline__",
+        "inline",
+        NULL
+    };
+    static const char inline_code[] = "static %s int f() { return 1; }";
+    char code_buf[100];
+    const char *inline_keyword = "";
+    int i;
+
+    for (i = 0; inline_options[i] != NULL; i++) {
+        sprintf(code_buf, inline_code, inline_options[i]);
+        if (chaz_CC_test_compile(code_buf)) {
+            inline_keyword = inline_options[i];
+            break;
+        }
+    }
+    chaz_ConfWriter_append_conf("#ifdef CHY_EMPLOY_ALIGNED_ALLOC\n");
+    chaz_ConfWriter_append_conf("#include <stdlib.h>\n");
+    chaz_ConfWriter_append_conf("#define CHY_MEMORY_INLINE static %s\n",
+                                inline_keyword);
+    for (i = 0; lines[i] != NULL; i++) {
+        chaz_ConfWriter_append_conf("%s", lines[i]);
+    }
+    chaz_ConfWriter_append_conf("#endif\n\n");
+}
+
+static void
+chaz_Memory_probe_aligned_alloc(void) {
+    static const char posix_memalign_code[] =
+        CHAZ_QUOTE(  #include <stdlib.h>                            )
+        CHAZ_QUOTE(  int main() {                                   )
+        CHAZ_QUOTE(      void *ptr = NULL;                          )
+        CHAZ_QUOTE(      if (posix_memalign(&ptr, 64, 100) != 0) {  )
+        CHAZ_QUOTE(          return 1;                              )
+        CHAZ_QUOTE(      }                                          )
+        CHAZ_QUOTE(      free(ptr);                                 )
+        CHAZ_QUOTE(      return 0;                                  )
+        CHAZ_QUOTE(  }                                              );
+    static const char aligned_alloc_code[] =
+        CHAZ_QUOTE(  #include <stdlib.h>                            )
+        CHAZ_QUOTE(  int main() {                                   )
+        CHAZ_QUOTE(      void *ptr = aligned_alloc(64, 128);        )
+        CHAZ_QUOTE(      free(ptr);                                 )
+        CHAZ_QUOTE(      return 0;                                  )
+        CHAZ_QUOTE(  }                                              );
+    static const char aligned_malloc_code[] =
+        CHAZ_QUOTE(  #include <malloc.h>                            )
+        CHAZ_QUOTE(  int main() {                                   )
+        CHAZ_QUOTE(      void *ptr = _aligned_malloc(100, 64);      )
+        CHAZ_QUOTE(      _aligned_free(ptr);                        )
+        CHAZ_QUOTE(      return 0;                                  )
+        CHAZ_QUOTE(  }                                              );
+    static const char memalign_code[] =
+        CHAZ_QUOTE(  #include <stdlib.h>                            )
+        CHAZ_QUOTE(  #include <malloc.h>                            )
+        CHAZ_QUOTE(  int main() {                                   )
+        CHAZ_QUOTE(      void *ptr = memalign(64, 100);             )
+        CHAZ_QUOTE(      free(ptr);                                 )
+        CHAZ_QUOTE(      return 0;                                  )
+        CHAZ_QUOTE(  }                                              );
+    /* Memory from _aligned_malloc must not be passed to free(), so it
+     * takes precedence on Windows where the other functions are usually
+     * missing anyway. */
+    static const char *const aligned_malloc_macros[] = {
+        "#define chy_aligned_alloc(alignment, size) \\\n",
+        "    _aligned_malloc((size), (alignment))\n",
+        "#define chy_aligned_free(ptr) _aligned_free(ptr)\n",
+        NULL
+    };
+    static const char *const posix_memalign_helpers[] = {
+        "CHY_MEMORY_INLINE void*\n",
+        "chy_aligned_alloc(size_t alignment, size_t size) {\n",
+        "    void *ptr;\n",
+        "    if (alignment < sizeof(void*)) { alignment = sizeof(void*); }\n",
+        "    if (posix_memalign(&ptr, alignment, size) != 0) { return 0; }\n",
+        "    return ptr;\n",
+        "}\n",
+        "#define chy_aligned_free(ptr) free(ptr)\n",
+        NULL
+    };
+    /* C11 requires the size to be a multiple of the alignment. */
+    static const char *const aligned_alloc_macros[] = {
+        "#define chy_aligned_alloc(alignment, size) \\\n",
+        "    aligned_alloc((alignment), \\\n",
+        "                  ((size) + (alignment) - 1) / (alignment) \\\n",
+        "                  * (alignment))\n",
+        "#define chy_aligned_free(ptr) free(ptr)\n",
+        NULL
+    };
+    static const char *const memalign_macros[] = {
+        "#define chy_aligned_alloc(alignment, size) \\\n",
+        "    memalign((alignment), (size))\n",
+        "#define chy_aligned_free(ptr) free(ptr)\n",
+        NULL
+    };
+    /* Over-allocate with malloc and store the original pointer in front of
+     * the aligned block. */
+    static const char *const malloc_helpers[] = {
+        "CHY_MEMORY_INLINE void*\n",
+        "chy_aligned_alloc(size_t alignment, size_t size) {\n",
+        "    char *raw;\n",
+        "    char *ptr;\n",
+        "    if (alignment < sizeof(void*)) { alignment = sizeof(void*); }\n",
+        "    raw = (char*)malloc(size + alignment + sizeof(void*));\n",
+        "    if (raw == 0) { return 0; }\n",
+        "    ptr = raw + sizeof(void*);\n",
+        "    ptr += (alignment - (size_t)ptr % alignment) % alignment;\n",
+        "    ((void**)ptr)[-1] = raw;\n",
+        "    return ptr;\n",
+        "}\n",
+        "CHY_MEMORY_INLINE void\n",
+        "chy_aligned_free(void *ptr) {\n",
+        "    if (ptr != 0) { free(((void**)ptr)[-1]); }\n",
+        "}\n",
+        NULL
+    };
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    int has_posix_memalign = false;
+    int has_aligned_alloc  = false;
+    int has_aligned_malloc = false;
+    int has_memalign       = false;
+
+    /* Without a prototype, the implicitly declared functions return int,
+     * which only triggers a warning. */
+    chaz_CFlags_set_warnings_as_errors(temp_cflags);
+    if (chaz_CC_test_link(posix_memalign_code)) {
+        has_posix_memalign = true;
+        chaz_ConfWriter_add_def("HAS_POSIX_MEMALIGN", NULL);
+    }
+    if (chaz_CC_test_link(aligned_alloc_code)) {
+        has_aligned_alloc = true;
+        chaz_ConfWriter_add_def("HAS_ALIGNED_ALLOC", NULL);
+    }
+    if (chaz_CC_test_link(aligned_malloc_code)) {
+        has_aligned_malloc = true;
+        chaz_ConfWriter_add_def("HAS_ALIGNED_MALLOC", NULL);
+    }
+    if (chaz_CC_test_link(memalign_code)) {
+        has_memalign = true;
+        chaz_ConfWriter_add_def("HAS_MEMALIGN", NULL);
+    }
+    chaz_CFlags_clear(temp_cflags);
+
+    if (has_aligned_malloc) {
+        chaz_Memory_write_macros(aligned_malloc_macros);
+    }
+    else if (has_posix_memalign) {
+        chaz_Memory_write_helpers(posix_memalign_helpers);
+    }
+    else if (has_aligned_alloc) {
+        chaz_Memory_write_macros(aligned_alloc_macros);
+    }
+    else if (has_memalign) {
+        chaz_Memory_write_macros(memalign_macros);
+    }
+    else {
+        chaz_Memory_write_helpers(malloc_helpers);
+    }
+}
+
+static void
+chaz_Memory_probe_mman(void) {
+    static const char constant_code[] =
+        CHAZ_QUOTE(  #include <sys/types.h>                         )
+        CHAZ_QUOTE(  #include <sys/mman.h>                          )
+        CHAZ_QUOTE(  int main() {                                   )
+        CHAZ_QUOTE(      int value = %s;                            )
+        CHAZ_QUOTE(      return value == -1;                        )
+        CHAZ_QUOTE(  }                                              );
+    static const char madvise_code[] =
+        CHAZ_QUOTE(  #include <sys/types.h>                         )
+        CHAZ_QUOTE(  #include <sys/mman.h>                          )
+        CHAZ_QUOTE(  static char buf[8192];                         )
+        CHAZ_QUOTE(  int main() {                                   )
+        CHAZ_QUOTE(      return madvise(buf, 4096, MADV_NORMAL);    )
+        CHAZ_QUOTE(  }                                              );
+    static const char mlock_code[] =
+        CHAZ_QUOTE(  #include <sys/types.h>                         )
+        CHAZ_QUOTE(  #include <sys/mman.h>                          )
+        CHAZ_QUOTE(  static char buf[8192];                         )
+        CHAZ_QUOTE(  int main() {                                   )
+        CHAZ_QUOTE(      if (mlock(buf, 4096) != 0) { return 1; }   )
+        CHAZ_QUOTE(      return munlock(buf, 4096);                 )
+        CHAZ_QUOTE(  }                                              );
+    static const char *constants[][2] = {
+        { "HAS_MAP_ANONYMOUS", "MAP_ANONYMOUS" },
+        { "HAS_MAP_ANON",      "MAP_ANON"      },
+        { "HAS_MAP_HUGETLB",   "MAP_HUGETLB"   },
+        { "HAS_MADV_HUGEPAGE", "MADV_HUGEPAGE" },
+        { "HAS_MADV_DONTNEED", "MADV_DONTNEED" },
+        { "HAS_MADV_FREE",     "MADV_FREE"     }
+    };
+    int num_constants = sizeof(constants) / sizeof(constants[0]);
+    char code_buf[sizeof(constant_code) + 100];
+    int i;
+
+    if (!chaz_HeadCheck_check_header("sys/mman.h")) {
+        return;
+    }
+
+    for (i = 0; i < num_constants; i++) {
+        sprintf(code_buf, constant_code, constants[i][1]);
+        if (chaz_CC_test_compile(code_buf)) {
+            chaz_ConfWriter_add_def(constants[i][0], NULL);
+        }
+    }
+    if (chaz_CC_test_link(madvise_code)) {
+        chaz_ConfWriter_add_def("HAS_MADVISE", NULL);
+    }
+    if (chaz_CC_test_link(mlock_code)) {
+        chaz_ConfWriter_add_def("HAS_MLOCK", NULL);
+    }
+}
+
+static void
+chaz_Memory_probe_virtual_alloc(void) {
+    static const char large_pages_code[] =
+        CHAZ_QUOTE(  #include <windows.h>                           )
+        CHAZ_QUOTE(  int main() {                                   )
+        CHAZ_QUOTE(      SIZE_T size = GetLargePageMinimum();       )
+        CHAZ_QUOTE(      DWORD type = MEM_RESERVE | MEM_COMMIT;     )
+        CHAZ_QUOTE(      void *ptr;                                 )
+        CHAZ_QUOTE(      type |= MEM_LARGE_PAGES;                   )
+        CHAZ_QUOTE(      ptr = VirtualAlloc(NULL, size, type, PAGE_READWRITE);)
+        CHAZ_QUOTE(      if (ptr) { VirtualFree(ptr, 0, MEM_RELEASE); })
+        CHAZ_QUOTE(      return 0;                                  )
+        CHAZ_QUOTE(  }                                              );
+
+    if (chaz_CC_binary_format() != CHAZ_CC_BINFMT_PE) {
+        return;
+    }
+    if (chaz_CC_test_link(large_pages_code)) {
+        chaz_ConfWriter_add_def("HAS_VIRTUAL_ALLOC_LARGE_PAGES", NULL);
+    }
+}
 
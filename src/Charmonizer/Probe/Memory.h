@@ -39,6 +39,47 @@ extern "C" {
  * Defined if alloca() is available via stdlib.h:
  *
  * ALLOCA_IN_STDLIB_H
+ *
+ * These symbols will be defined if the associated aligned allocation
+ * function is available:
+ *
+ * HAS_POSIX_MEMALIGN      posix_memalign
+ * HAS_ALIGNED_ALLOC       aligned_alloc
+ * HAS_ALIGNED_MALLOC      _aligned_malloc, _aligned_free
+ * HAS_MEMALIGN            memalign
+ *
+ * In any case, the following pair is generated from the best available
+ * function, falling back to over-allocation with malloc.  The alignment
+ * must be a power of two.  Memory returned by chy_aligned_alloc must be
+ * released with chy_aligned_free:
+ *
+ * void *chy_aligned_alloc(size_t alignment, size_t size);
+ * void  chy_aligned_free(void *ptr);
+ *
+ * If _aligned_malloc, aligned_alloc or memalign is used, these are macros
+ * and the caller must include <stdlib.h>, and <malloc.h> if HAS_MALLOC_H is
+ * defined.  With posix_memalign or the malloc fallback, they are inline
+ * functions which are only defined if CHY_EMPLOY_ALIGNED_ALLOC is defined
+ * before charmony.h is included:
+ *
+ *     #define CHY_EMPLOY_ALIGNED_ALLOC
+ *     #include "charmony.h"
+ *
+ * These symbols will be defined if the associated mmap flag, madvise
+ * advice or function is available in <sys/mman.h>:
+ *
+ * HAS_MAP_ANONYMOUS
+ * HAS_MAP_ANON
+ * HAS_MAP_HUGETLB
+ * HAS_MADVISE
+ * HAS_MADV_HUGEPAGE
+ * HAS_MADV_DONTNEED
+ * HAS_MADV_FREE
+ * HAS_MLOCK               mlock, munlock
+ *
+ * Defined if VirtualAlloc accepts MEM_LARGE_PAGES:
+ *
+ * HAS_VIRTUAL_ALLOC_LARGE_PAGES
  */
 void chaz_Memory_run(void);
 
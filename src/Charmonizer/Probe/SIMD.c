@@ -0,0 +1,217 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Charmonizer/Probe/SIMD.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/Util.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* An instruction set, the code used to test it and the candidate flags for
+ * GNU-style compilers and MSVC.  An empty string stands for "no extra flags
+ * needed".
+ */
+typedef struct chaz_SIMD_isa {
+    const char *name;
+    const char *code;
+    const char *gnu_flags[3];
+    const char *msvc_flags[3];
+    const char *cflags;
+} chaz_SIMD_isa;
+
+static const char chaz_SIMD_sse2_code[] =
+    "#include <emmintrin.h>\n"
+    "int main(int argc, char **argv) {\n"
+    "    __m128i v = _mm_set1_epi32(argc);\n"
+    "    v = _mm_add_epi32(v, v);\n"
+    "    (void)argv;\n"
+    "    return _mm_cvtsi128_si32(v);\n"
+    "}\n";
+
+static const char chaz_SIMD_sse4_2_code[] =
+    "#include <nmmintrin.h>\n"
+    "int main(int argc, char **argv) {\n"
+    "    unsigned crc = _mm_crc32_u32(0u, (unsigned)argc);\n"
+    "    __m128i v = _mm_set1_epi32(argc);\n"
+    "    (void)argv;\n"
+    "    return (int)crc + _mm_extract_epi32(v, 1);\n"
+    "}\n";
+
+static const char chaz_SIMD_avx2_code[] =
+    "#include <immintrin.h>\n"
+    "int main(int argc, char **argv) {\n"
+    "    __m256i v = _mm256_set1_epi32(argc);\n"
+    "    v = _mm256_add_epi32(v, v);\n"
+    "    (void)argv;\n"
+    "    return _mm_cvtsi128_si32(_mm256_castsi256_si128(v));\n"
+    "}\n";
+
+static const char chaz_SIMD_avx512f_code[] =
+    "#include <immintrin.h>\n"
+    "int main(int argc, char **argv) {\n"
+    "    __m512i v = _mm512_set1_epi32(argc);\n"
+    "    v = _mm512_add_epi32(v, v);\n"
+    "    (void)argv;\n"
+    "    return _mm_cvtsi128_si32(_mm512_castsi512_si128(v));\n"
+    "}\n";
+
+static const char chaz_SIMD_neon_code[] =
+    "#include <arm_neon.h>\n"
+    "int main(int argc, char **argv) {\n"
+    "    int32x4_t v = vdupq_n_s32(argc);\n"
+    "    v = vaddq_s32(v, v);\n"
+    "    (void)argv;\n"
+    "    return vgetq_lane_s32(v, 0);\n"
+    "}\n";
+
+static const char chaz_SIMD_sve_code[] =
+    "#include <arm_sve.h>\n"
+    "int main(int argc, char **argv) {\n"
+    "    svint32_t v = svdup_n_s32(argc);\n"
+    "    (void)argv;\n"
+    "    return (int)svaddv_s32(svptrue_b32(), v);\n"
+    "}\n";
+
+/* Module vars.  With MSVC, the /arch switches are tried first because the
+ * intrinsics compile without them, but the switches also let the compiler
+ * vectorize the surrounding code.
+ */
+static struct {
+    chaz_SIMD_isa isas[6];
+} chaz_SIMD = {
+    {
+        {
+            "SSE2", chaz_SIMD_sse2_code,
+            { "", "-msse2", NULL },
+            { "", NULL, NULL },
+            NULL
+        },
+        {
+            "SSE4_2", chaz_SIMD_sse4_2_code,
+            { "", "-msse4.2", NULL },
+            { "", NULL, NULL },
+            NULL
+        },
+        {
+            "AVX2", chaz_SIMD_avx2_code,
+            { "", "-mavx2", NULL },
+            { "/arch:AVX2", "", NULL },
+            NULL
+        },
+        {
+            "AVX512F", chaz_SIMD_avx512f_code,
+            { "", "-mavx512f", NULL },
+            { "/arch:AVX512", "", NULL },
+            NULL
+        },
+        {
+            "NEON", chaz_SIMD_neon_code,
+            { "", "-mfpu=neon", NULL },
+            { "", NULL, NULL },
+            NULL
+        },
+        {
+            "SVE", chaz_SIMD_sve_code,
+            { "", "-march=armv8-a+sve", NULL },
+            { NULL, NULL, NULL },
+            NULL
+        }
+    }
+};
+
+/* Try the candidate flags for an instruction set.  Return the first flags
+ * that work or NULL.
+ */
+static const char*
+chaz_SIMD_probe_isa(chaz_SIMD_isa *isa);
+
+void
+chaz_SIMD_run(void) {
+    int num_isas = sizeof(chaz_SIMD.isas) / sizeof(chaz_SIMD.isas[0]);
+    int i;
+
+    chaz_ConfWriter_start_module("SIMD");
+
+    for (i = 0; i < num_isas; i++) {
+        chaz_SIMD_isa *isa = &chaz_SIMD.isas[i];
+        isa->cflags = chaz_SIMD_probe_isa(isa);
+        if (isa->cflags) {
+            char *has_sym   = chaz_Util_join("_", "HAS", isa->name, NULL);
+            char *flags_sym = chaz_Util_join("_", isa->name, "CFLAGS", NULL);
+            char *value     = chaz_Util_join("", "\"", isa->cflags, "\"",
+                                             NULL);
+            chaz_ConfWriter_add_def(has_sym, NULL);
+            chaz_ConfWriter_add_def(flags_sym, value);
+            free(has_sym);
+            free(flags_sym);
+            free(value);
+        }
+    }
+
+    chaz_ConfWriter_end_module();
+}
+
+static const char*
+chaz_SIMD_probe_isa(chaz_SIMD_isa *isa) {
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    const char *const *candidates;
+    const char *result = NULL;
+    int i;
+
+    if (chaz_CC_is_msvc()) {
+        candidates = isa->msvc_flags;
+    }
+    else if (chaz_CC_is_gcc()) {
+        candidates = isa->gnu_flags;
+    }
+    else {
+        /* Unknown compiler: only check whether the intrinsics work out of
+         * the box. */
+        static const char *const no_flags[] = { "", NULL };
+        candidates = no_flags;
+    }
+
+    /* Unknown switches only produce a warning with some compilers. */
+    for (i = 0; candidates[i] != NULL && result == NULL; i++) {
+        chaz_CFlags_set_warnings_as_errors(temp_cflags);
+        if (candidates[i][0] != '\0') {
+            chaz_CFlags_append(temp_cflags, candidates[i]);
+        }
+        if (chaz_CC_test_link(isa->code)) {
+            result = candidates[i];
+        }
+        chaz_CFlags_clear(temp_cflags);
+    }
+
+    return result;
+}
+
+const char*
+chaz_SIMD_get_cflags(const char *isa) {
+    int num_isas = sizeof(chaz_SIMD.isas) / sizeof(chaz_SIMD.isas[0]);
+    int i;
+
+    for (i = 0; i < num_isas; i++) {
+        if (strcmp(chaz_SIMD.isas[i].name, isa) == 0) {
+            return chaz_SIMD.isas[i].cflags;
+        }
+    }
+
+    return NULL;
+}
+
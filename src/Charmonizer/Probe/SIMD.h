@@ -0,0 +1,74 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Probe/SIMD.h
+ */
+
+#ifndef H_CHAZ_SIMD
+#define H_CHAZ_SIMD
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The SIMD module checks which vector instruction sets can be used with the
+ * configured compiler.  For each instruction set, it tries to compile and
+ * link a program which includes the intrinsics header and uses a
+ * representative intrinsic, first with the current flags and then with
+ * the compiler switches that enable the instruction set.
+ *
+ * These symbols will be defined if the associated instruction set is
+ * available:
+ *
+ * HAS_SSE2                <emmintrin.h>
+ * HAS_SSE4_2              <nmmintrin.h>
+ * HAS_AVX2                <immintrin.h>
+ * HAS_AVX512F             <immintrin.h>
+ * HAS_NEON                <arm_neon.h>
+ * HAS_SVE                 <arm_sve.h>
+ *
+ * For each available instruction set, a string literal containing the
+ * compiler flags needed to use it will be defined as well.  The string is
+ * empty if no extra flags are required:
+ *
+ * SSE2_CFLAGS
+ * SSE4_2_CFLAGS
+ * AVX2_CFLAGS
+ * AVX512F_CFLAGS
+ * NEON_CFLAGS
+ * SVE_CFLAGS
+ *
+ * The flags are meant for source files containing the vectorized code
+ * only, so that the rest of the project still runs on CPUs lacking the
+ * instruction set.
+ */
+void chaz_SIMD_run(void);
+
+/* Return the compiler flags needed for the instruction set `isa` (one of
+ * the names above, e.g. "AVX2"), or NULL if it isn't available or hasn't
+ * been probed with chaz_SIMD_run.  An empty string means that no extra
+ * flags are needed.  The result can be appended to the compile flags of a
+ * chaz_MakeBinary.
+ */
+const char*
+chaz_SIMD_get_cflags(const char *isa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_SIMD */
+
@@ -0,0 +1,222 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Charmonizer/Probe/ThreadLocal.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/Util.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char chaz_ThreadLocal_exe_code[] =
+    CHAZ_QUOTE(  static %s int chaz_tls_var;          )
+    CHAZ_QUOTE(  int main() {                         )
+    CHAZ_QUOTE(      chaz_tls_var = 1;                )
+    CHAZ_QUOTE(      return chaz_tls_var - 1;         )
+    CHAZ_QUOTE(  }                                    );
+
+static const char chaz_ThreadLocal_lib_code[] =
+    CHAZ_QUOTE(  static %s int chaz_tls_var;          )
+    CHAZ_QUOTE(  int chaz_tls_get(void);              )
+    CHAZ_QUOTE(  int chaz_tls_get(void) {             )
+    CHAZ_QUOTE(      return ++chaz_tls_var;           )
+    CHAZ_QUOTE(  }                                    );
+
+/* Return the first thread-local storage class which works or NULL.
+ */
+static const char*
+chaz_ThreadLocal_probe_keyword(void);
+
+/* Try to build a shared library with a thread-local variable declared with
+ * `storage_class`.
+ */
+static int
+chaz_ThreadLocal_try_shared_lib(const char *storage_class);
+
+/* Probe for the tls_model attribute.  Return the attribute for the
+ * initial-exec model or NULL.
+ */
+static const char*
+chaz_ThreadLocal_probe_tls_model(const char *keyword);
+
+/* Probe for pthread_key_create.
+ */
+static int
+chaz_ThreadLocal_probe_pthread_key(void);
+
+void
+chaz_ThreadLocal_run(void) {
+    const char *keyword;
+    int has_pthread_key;
+
+    chaz_ConfWriter_start_module("ThreadLocal");
+
+    keyword = chaz_ThreadLocal_probe_keyword();
+    if (keyword) {
+        const char *initial_exec;
+        const char *spelling = keyword;
+
+        /* _Thread_local is C-only. C++ compilers get thread_local, or
+         * __thread before C++11. */
+        if (strcmp(keyword, "_Thread_local") == 0) {
+            chaz_ConfWriter_append_conf(
+                "#if defined(__cplusplus) && __cplusplus < 201103L \\\n"
+                "    && defined(__GNUC__)\n"
+                "  #define CHY_THREAD_LOCAL_KEYWORD __thread\n"
+                "#elif defined(__cplusplus)\n"
+                "  #define CHY_THREAD_LOCAL_KEYWORD thread_local\n"
+                "#else\n"
+                "  #define CHY_THREAD_LOCAL_KEYWORD _Thread_local\n"
+                "#endif\n");
+            spelling = "CHY_THREAD_LOCAL_KEYWORD";
+        }
+
+        chaz_ConfWriter_add_def("HAS_THREAD_LOCAL", NULL);
+        chaz_ConfWriter_add_def("THREAD_LOCAL", spelling);
+        if (chaz_ThreadLocal_try_shared_lib(keyword)) {
+            chaz_ConfWriter_add_def("HAS_THREAD_LOCAL_IN_SHARED_LIB", NULL);
+        }
+
+        initial_exec = chaz_ThreadLocal_probe_tls_model(keyword);
+        if (initial_exec) {
+            char *fast = chaz_Util_join(" ", spelling, initial_exec, NULL);
+            chaz_ConfWriter_add_def("TLS_FAST", fast);
+            free(fast);
+        }
+        else {
+            chaz_ConfWriter_add_def("TLS_FAST", spelling);
+        }
+    }
+
+    has_pthread_key = chaz_ThreadLocal_probe_pthread_key();
+    if (has_pthread_key) {
+        chaz_ConfWriter_add_def("HAS_PTHREAD_KEY_CREATE", NULL);
+        if (!keyword) {
+            chaz_ConfWriter_add_def("TLS_USE_PTHREAD_KEY", NULL);
+        }
+    }
+
+    chaz_ConfWriter_end_module();
+}
+
+static const char*
+chaz_ThreadLocal_probe_keyword(void) {
+    static const char *keywords[] = {
+        "_Thread_local",
+        "__thread",
+        "__declspec(thread)",
+        "thread_local",
+        NULL
+    };
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    char code_buf[sizeof(chaz_ThreadLocal_exe_code) + 100];
+    const char *keyword = NULL;
+    int i;
+
+    /* Unknown declspecs only produce a warning with some compilers. */
+    chaz_CFlags_set_warnings_as_errors(temp_cflags);
+    for (i = 0; keywords[i] != NULL; i++) {
+        sprintf(code_buf, chaz_ThreadLocal_exe_code, keywords[i]);
+        if (chaz_CC_test_link(code_buf)) {
+            keyword = keywords[i];
+            break;
+        }
+    }
+    chaz_CFlags_clear(temp_cflags);
+
+    return keyword;
+}
+
+static int
+chaz_ThreadLocal_try_shared_lib(const char *storage_class) {
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    char *code;
+    int result;
+
+    /* Windows DLLs support __declspec(thread) since Vista. */
+    if (chaz_CC_binary_format() == CHAZ_CC_BINFMT_PE) {
+        return 1;
+    }
+
+    code = (char*)malloc(sizeof(chaz_ThreadLocal_lib_code)
+                         + strlen(storage_class) + 1);
+    sprintf(code, chaz_ThreadLocal_lib_code, storage_class);
+    chaz_CFlags_set_warnings_as_errors(temp_cflags);
+    chaz_CFlags_compile_shared_library(temp_cflags);
+    chaz_CFlags_link_shared_library(temp_cflags, "charm_tls", "1.0.0", "1");
+    result = chaz_CC_test_link(code);
+    chaz_CFlags_clear(temp_cflags);
+    free(code);
+
+    return result;
+}
+
+static const char*
+chaz_ThreadLocal_probe_tls_model(const char *keyword) {
+    static const char initial_exec[]
+        = "__attribute__((tls_model(\"initial-exec\")))";
+    static const char local_dynamic[]
+        = "__attribute__((tls_model(\"local-dynamic\")))";
+    const char *result = NULL;
+    char *storage_class;
+
+    if (!chaz_CC_is_gcc()
+        || chaz_CC_binary_format() != CHAZ_CC_BINFMT_ELF
+       ) {
+        return NULL;
+    }
+
+    storage_class = chaz_Util_join(" ", keyword, initial_exec, NULL);
+    if (chaz_ThreadLocal_try_shared_lib(storage_class)) {
+        chaz_ConfWriter_add_def("HAS_TLS_MODEL_INITIAL_EXEC", NULL);
+        result = initial_exec;
+    }
+    free(storage_class);
+
+    storage_class = chaz_Util_join(" ", keyword, local_dynamic, NULL);
+    if (chaz_ThreadLocal_try_shared_lib(storage_class)) {
+        chaz_ConfWriter_add_def("HAS_TLS_MODEL_LOCAL_DYNAMIC", NULL);
+    }
+    free(storage_class);
+
+    return result;
+}
+
+static int
+chaz_ThreadLocal_probe_pthread_key(void) {
+    static const char pthread_key_code[] =
+        CHAZ_QUOTE(  #include <pthread.h>                           )
+        CHAZ_QUOTE(  int main() {                                   )
+        CHAZ_QUOTE(      pthread_key_t key;                         )
+        CHAZ_QUOTE(      if (pthread_key_create(&key, 0) != 0) {    )
+        CHAZ_QUOTE(          return 1;                              )
+        CHAZ_QUOTE(      }                                          )
+        CHAZ_QUOTE(      pthread_setspecific(key, &key);            )
+        CHAZ_QUOTE(      return pthread_getspecific(key) != &key;   )
+        CHAZ_QUOTE(  }                                              );
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    int result = chaz_CC_test_link(pthread_key_code);
+
+    if (!result && chaz_CC_is_gcc()) {
+        chaz_CFlags_append(temp_cflags, "-pthread");
+        result = chaz_CC_test_link(pthread_key_code);
+        chaz_CFlags_clear(temp_cflags);
+    }
+
+    return result;
+}
+
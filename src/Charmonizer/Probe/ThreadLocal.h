@@ -0,0 +1,71 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Probe/ThreadLocal.h
+ */
+
+#ifndef H_CHAZ_THREADLOCAL
+#define H_CHAZ_THREADLOCAL
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The ThreadLocal module probes for thread-local storage.  Variables are
+ * declared as "static CHY_THREAD_LOCAL int foo;".
+ *
+ * Defined if a thread-local storage class works, along with the spelling,
+ * one of _Thread_local, __thread, __declspec(thread) or thread_local.
+ * _Thread_local is replaced with thread_local when compiling C++, or with
+ * __thread for GCC-compatible compilers before C++11:
+ *
+ * HAS_THREAD_LOCAL
+ * THREAD_LOCAL
+ *
+ * Defined if thread-local variables also work in code compiled and linked
+ * as a shared library:
+ *
+ * HAS_THREAD_LOCAL_IN_SHARED_LIB
+ *
+ * Defined if the tls_model attribute accepts these models in code compiled
+ * for a shared library:
+ *
+ * HAS_TLS_MODEL_INITIAL_EXEC
+ * HAS_TLS_MODEL_LOCAL_DYNAMIC
+ *
+ * TLS_FAST is THREAD_LOCAL combined with the initial-exec model if it is
+ * available.  The initial-exec model avoids a call to __tls_get_addr for
+ * each access, but shared libraries using it can fail to load with dlopen
+ * if the static TLS space of the process is exhausted, so TLS_FAST should
+ * be reserved for small per-thread caches:
+ *
+ * TLS_FAST
+ *
+ * Defined if pthread_key_create is available.  TLS_USE_PTHREAD_KEY is
+ * defined if it must be used because there's no thread-local storage
+ * class:
+ *
+ * HAS_PTHREAD_KEY_CREATE
+ * TLS_USE_PTHREAD_KEY
+ */
+void chaz_ThreadLocal_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_THREADLOCAL */
+
@@ -0,0 +1,308 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Charmonizer/Probe/Threads.h"
+#include "Charmonizer/Core/CFlags.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/Util.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct chaz_Threads_feature {
+    const char *sym;
+    const char *code;
+} chaz_Threads_feature;
+
+static const char chaz_Threads_pthread_code[] =
+    CHAZ_QUOTE(  #include <pthread.h>                                  )
+    CHAZ_QUOTE(  static void *chaz_thread_func(void *arg) {            )
+    CHAZ_QUOTE(      return arg;                                       )
+    CHAZ_QUOTE(  }                                                     )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      pthread_t t;                                      )
+    CHAZ_QUOTE(      void *result;                                     )
+    CHAZ_QUOTE(      if (pthread_create(&t, 0, chaz_thread_func, &t)) {)
+    CHAZ_QUOTE(          return 1;                                     )
+    CHAZ_QUOTE(      }                                                 )
+    CHAZ_QUOTE(      if (pthread_join(t, &result)) { return 1; }       )
+    CHAZ_QUOTE(      return result != &t;                              )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_Threads_spin_code[] =
+    CHAZ_QUOTE(  #include <pthread.h>                                  )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      pthread_spinlock_t lock;                          )
+    CHAZ_QUOTE(      pthread_spin_init(&lock, PTHREAD_PROCESS_PRIVATE);)
+    CHAZ_QUOTE(      pthread_spin_lock(&lock);                         )
+    CHAZ_QUOTE(      pthread_spin_trylock(&lock);                      )
+    CHAZ_QUOTE(      pthread_spin_unlock(&lock);                       )
+    CHAZ_QUOTE(      return pthread_spin_destroy(&lock);               )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_Threads_adaptive_code[] =
+    CHAZ_QUOTE(  #define _GNU_SOURCE                                   )
+    CHAZ_QUOTE(  #include <pthread.h>                                  )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      pthread_mutexattr_t attr;                         )
+    CHAZ_QUOTE(      int type = PTHREAD_MUTEX_ADAPTIVE_NP;             )
+    CHAZ_QUOTE(      pthread_mutexattr_init(&attr);                    )
+    CHAZ_QUOTE(      return pthread_mutexattr_settype(&attr, type);    )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_Threads_rwlock_code[] =
+    CHAZ_QUOTE(  #include <pthread.h>                                  )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      pthread_rwlock_t lock;                            )
+    CHAZ_QUOTE(      pthread_rwlock_init(&lock, 0);                    )
+    CHAZ_QUOTE(      pthread_rwlock_rdlock(&lock);                     )
+    CHAZ_QUOTE(      pthread_rwlock_unlock(&lock);                     )
+    CHAZ_QUOTE(      pthread_rwlock_wrlock(&lock);                     )
+    CHAZ_QUOTE(      pthread_rwlock_unlock(&lock);                     )
+    CHAZ_QUOTE(      return pthread_rwlock_destroy(&lock);             )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_Threads_futex_code[] =
+    CHAZ_QUOTE(  #define _GNU_SOURCE                                   )
+    CHAZ_QUOTE(  #include <linux/futex.h>                              )
+    CHAZ_QUOTE(  #include <sys/syscall.h>                              )
+    CHAZ_QUOTE(  #include <unistd.h>                                   )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      int word = 0;                                     )
+    CHAZ_QUOTE(      int op = FUTEX_WAKE_PRIVATE;                      )
+    CHAZ_QUOTE(      return syscall(SYS_futex, &word, op, 1, 0, 0, 0); )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_Threads_wait_on_address_code[] =
+    CHAZ_QUOTE(  #define _WIN32_WINNT 0x0602                           )
+    CHAZ_QUOTE(  #include <windows.h>                                  )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      LONG word = 0;                                    )
+    CHAZ_QUOTE(      LONG undesired = 1;                               )
+    CHAZ_QUOTE(      WaitOnAddress(&word, &undesired, sizeof(LONG), 0);)
+    CHAZ_QUOTE(      WakeByAddressSingle(&word);                       )
+    CHAZ_QUOTE(      return 0;                                         )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_Threads_sched_yield_code[] =
+    CHAZ_QUOTE(  #include <sched.h>                                    )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      return sched_yield();                             )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_Threads_pthread_affinity_code[] =
+    CHAZ_QUOTE(  #define _GNU_SOURCE                                   )
+    CHAZ_QUOTE(  #include <pthread.h>                                  )
+    CHAZ_QUOTE(  #include <sched.h>                                    )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      cpu_set_t set;                                    )
+    CHAZ_QUOTE(      pthread_t self = pthread_self();                  )
+    CHAZ_QUOTE(      CPU_ZERO(&set);                                   )
+    CHAZ_QUOTE(      CPU_SET(0, &set);                                 )
+    CHAZ_QUOTE(      return pthread_setaffinity_np(self, sizeof(set), &set);)
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_Threads_sched_affinity_code[] =
+    CHAZ_QUOTE(  #define _GNU_SOURCE                                   )
+    CHAZ_QUOTE(  #include <sched.h>                                    )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      cpu_set_t set;                                    )
+    CHAZ_QUOTE(      CPU_ZERO(&set);                                   )
+    CHAZ_QUOTE(      CPU_SET(0, &set);                                 )
+    CHAZ_QUOTE(      return sched_setaffinity(0, sizeof(set), &set);   )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_Threads_cpu_set_code[] =
+    CHAZ_QUOTE(  #define _GNU_SOURCE                                   )
+    CHAZ_QUOTE(  #include <sched.h>                                    )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      cpu_set_t set;                                    )
+    CHAZ_QUOTE(      CPU_ZERO(&set);                                   )
+    CHAZ_QUOTE(      CPU_SET(0, &set);                                 )
+    CHAZ_QUOTE(      return !CPU_ISSET(0, &set);                       )
+    CHAZ_QUOTE(  }                                                     );
+
+static const char chaz_Threads_threads_h_code[] =
+    CHAZ_QUOTE(  #include <threads.h>                                  )
+    CHAZ_QUOTE(  static int chaz_thread_func(void *arg) {              )
+    CHAZ_QUOTE(      return arg != 0;                                  )
+    CHAZ_QUOTE(  }                                                     )
+    CHAZ_QUOTE(  int main() {                                          )
+    CHAZ_QUOTE(      thrd_t t;                                         )
+    CHAZ_QUOTE(      int result = thrd_create(&t, chaz_thread_func, 0);)
+    CHAZ_QUOTE(      if (result != thrd_success) { return 1; }         )
+    CHAZ_QUOTE(      thrd_join(t, &result);                            )
+    CHAZ_QUOTE(      return result;                                    )
+    CHAZ_QUOTE(  }                                                     );
+
+static struct {
+    int pthread_flag;
+    int pthread_lib;
+    int synchronization_lib;
+    chaz_Threads_feature features[9];
+} chaz_Threads = {
+    0, 0, 0,
+    {
+        { "HAS_PTHREAD_SPINLOCK",          chaz_Threads_spin_code },
+        { "HAS_PTHREAD_MUTEX_ADAPTIVE_NP", chaz_Threads_adaptive_code },
+        { "HAS_PTHREAD_RWLOCK",            chaz_Threads_rwlock_code },
+        { "HAS_FUTEX",                     chaz_Threads_futex_code },
+        { "HAS_SCHED_YIELD",               chaz_Threads_sched_yield_code },
+        { "HAS_PTHREAD_SETAFFINITY_NP",
+          chaz_Threads_pthread_affinity_code },
+        { "HAS_SCHED_SETAFFINITY",
+          chaz_Threads_sched_affinity_code },
+        { "HAS_CPU_SET",                   chaz_Threads_cpu_set_code },
+        { "HAS_THREADS_H",                 chaz_Threads_threads_h_code }
+    }
+};
+
+/* Find the flags needed to link against pthreads.  Return true if
+ * successful.
+ */
+static int
+chaz_Threads_probe_pthreads(void);
+
+/* Probe for WaitOnAddress which lives in Synchronization.lib.
+ */
+static int
+chaz_Threads_probe_wait_on_address(void);
+
+/* Define a string literal containing the current contents of `flags`.
+ */
+static void
+chaz_Threads_define_flags(const char *sym, chaz_CFlags *flags);
+
+void
+chaz_Threads_run(void) {
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    int num_features = sizeof(chaz_Threads.features)
+                       / sizeof(chaz_Threads.features[0]);
+    int i;
+
+    chaz_ConfWriter_start_module("Threads");
+
+    if (chaz_Threads_probe_pthreads()) {
+        chaz_ConfWriter_add_def("HAS_PTHREADS", NULL);
+    }
+    if (chaz_Threads_probe_wait_on_address()) {
+        /* WaitOnAddress is only declared when targeting Windows 8. */
+        chaz_ConfWriter_append_conf(
+            "#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602\n"
+            "  #define CHY_HAS_WAIT_ON_ADDRESS\n"
+            "  #if defined(CHY_USE_SHORT_NAMES) "
+            "|| defined(CHAZ_USE_SHORT_NAMES)\n"
+            "    #define HAS_WAIT_ON_ADDRESS CHY_HAS_WAIT_ON_ADDRESS\n"
+            "  #endif\n"
+            "#endif\n\n");
+    }
+
+    /* Probe the remaining features with the threading flags in place. */
+    chaz_Threads_add_link_flags(temp_cflags);
+    for (i = 0; i < num_features; i++) {
+        chaz_Threads_feature *feature = &chaz_Threads.features[i];
+        if (chaz_CC_test_link(feature->code)) {
+            chaz_ConfWriter_add_def(feature->sym, NULL);
+        }
+    }
+    chaz_CFlags_clear(temp_cflags);
+
+    chaz_Threads_add_compile_flags(temp_cflags);
+    chaz_Threads_define_flags("THREADS_CFLAGS", temp_cflags);
+    chaz_CFlags_clear(temp_cflags);
+    chaz_Threads_add_link_flags(temp_cflags);
+    chaz_Threads_define_flags("THREADS_LDFLAGS", temp_cflags);
+    chaz_CFlags_clear(temp_cflags);
+
+    chaz_ConfWriter_end_module();
+}
+
+void
+chaz_Threads_add_compile_flags(chaz_CFlags *flags) {
+    if (chaz_Threads.pthread_flag) {
+        chaz_CFlags_append(flags, "-pthread");
+    }
+}
+
+void
+chaz_Threads_add_link_flags(chaz_CFlags *flags) {
+    if (chaz_Threads.pthread_flag) {
+        chaz_CFlags_append(flags, "-pthread");
+    }
+    if (chaz_Threads.pthread_lib) {
+        chaz_CFlags_add_external_lib(flags, "pthread");
+    }
+    if (chaz_Threads.synchronization_lib) {
+        chaz_CFlags_add_external_lib(flags, "Synchronization");
+    }
+}
+
+static int
+chaz_Threads_probe_pthreads(void) {
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+
+    /* -pthread also sets up preprocessor macros like _REENTRANT, so prefer
+     * it over linking against libpthread directly. */
+    if (chaz_CC_is_gcc()) {
+        chaz_CFlags_append(temp_cflags, "-pthread");
+        if (chaz_CC_test_link(chaz_Threads_pthread_code)) {
+            chaz_Threads.pthread_flag = 1;
+        }
+        chaz_CFlags_clear(temp_cflags);
+        if (chaz_Threads.pthread_flag) { return 1; }
+    }
+
+    if (!chaz_CC_is_msvc()) {
+        chaz_CFlags_add_external_lib(temp_cflags, "pthread");
+        if (chaz_CC_test_link(chaz_Threads_pthread_code)) {
+            chaz_Threads.pthread_lib = 1;
+        }
+        chaz_CFlags_clear(temp_cflags);
+        if (chaz_Threads.pthread_lib) { return 1; }
+    }
+
+    return chaz_CC_test_link(chaz_Threads_pthread_code);
+}
+
+static int
+chaz_Threads_probe_wait_on_address(void) {
+    chaz_CFlags *temp_cflags;
+
+    if (chaz_CC_binary_format() != CHAZ_CC_BINFMT_PE) { return 0; }
+
+    if (chaz_CC_test_link(chaz_Threads_wait_on_address_code)) {
+        return 1;
+    }
+
+    temp_cflags = chaz_CC_get_temp_cflags();
+    chaz_CFlags_add_external_lib(temp_cflags, "Synchronization");
+    if (chaz_CC_test_link(chaz_Threads_wait_on_address_code)) {
+        chaz_Threads.synchronization_lib = 1;
+    }
+    chaz_CFlags_clear(temp_cflags);
+
+    return chaz_Threads.synchronization_lib;
+}
+
+static void
+chaz_Threads_define_flags(const char *sym, chaz_CFlags *flags) {
+    char *value = chaz_Util_join("", "\"", chaz_CFlags_get_string(flags),
+                                 "\"", NULL);
+    chaz_ConfWriter_add_def(sym, value);
+    free(value);
+}
+
@@ -0,0 +1,82 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Probe/Threads.h
+ */
+
+#ifndef H_CHAZ_THREADS
+#define H_CHAZ_THREADS
+
+#include "Charmonizer/Core/CFlags.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The Threads module determines how to build threaded code and probes for
+ * threading and locking primitives.
+ *
+ * Defined if a program creating a POSIX thread can be linked.  The flags
+ * tried are -pthread, -lpthread and none, in that order:
+ *
+ * HAS_PTHREADS
+ *
+ * String literals containing the flags needed to compile and link threaded
+ * code.  The strings are empty if no extra flags are required:
+ *
+ * THREADS_CFLAGS
+ * THREADS_LDFLAGS
+ *
+ * These symbols will be defined if the associated feature is available.
+ * Features marked with (GNU) are only declared if _GNU_SOURCE is defined
+ * before including any system header:
+ *
+ * HAS_PTHREAD_SPINLOCK             pthread_spin_init etc.
+ * HAS_PTHREAD_MUTEX_ADAPTIVE_NP    (GNU)
+ * HAS_PTHREAD_RWLOCK               pthread_rwlock_init etc.
+ * HAS_FUTEX                        syscall(SYS_futex, ...) (GNU)
+ * HAS_WAIT_ON_ADDRESS              WaitOnAddress, WakeByAddressSingle
+ * HAS_SCHED_YIELD
+ * HAS_PTHREAD_SETAFFINITY_NP       (GNU)
+ * HAS_SCHED_SETAFFINITY            (GNU)
+ * HAS_CPU_SET                      cpu_set_t, CPU_ZERO, CPU_SET (GNU)
+ * HAS_THREADS_H                    C11 thrd_create etc.
+ *
+ * HAS_WAIT_ON_ADDRESS is only defined if _WIN32_WINNT is at least 0x0602
+ * (Windows 8) when charmony.h is included, as <windows.h> doesn't declare
+ * WaitOnAddress for older targets.
+ */
+void chaz_Threads_run(void);
+
+/* Add the flags needed to compile threaded code to `flags`.  Must be called
+ * after chaz_Threads_run.
+ */
+void
+chaz_Threads_add_compile_flags(chaz_CFlags *flags);
+
+/* Add the flags and libraries needed to link threaded code to `flags`,
+ * typically the link flags of a chaz_MakeBinary.  Must be called after
+ * chaz_Threads_run.
+ */
+void
+chaz_Threads_add_link_flags(chaz_CFlags *flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_THREADS */
+
@@ -0,0 +1,77 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+#define CHY_EMPLOY_ATOMICOPS
+
+#include "charmony.h"
+#include <stddef.h>
+#include "Charmonizer/Test.h"
+
+#ifdef HAS_ATOMIC_LAYER
+
+static CHY_ATOMIC(long) counter;
+static CHY_ATOMIC(void*) pointer;
+
+static void
+S_run_tests(void) {
+    long  expected;
+    void *expected_ptr = NULL;
+    int   value = 0;
+
+    chy_atomic_store(&counter, 5, ATOMIC_ORDER_RELEASE);
+    LONG_EQ(chy_atomic_load(&counter, ATOMIC_ORDER_ACQUIRE), 5,
+            "chy_atomic_store and chy_atomic_load");
+    chy_atomic_store(&counter, 6, ATOMIC_ORDER_SEQ_CST);
+    LONG_EQ(chy_atomic_load(&counter, ATOMIC_ORDER_RELAXED), 6,
+            "chy_atomic_store with ATOMIC_ORDER_SEQ_CST");
+
+    LONG_EQ(chy_atomic_fetch_add(&counter, 2, ATOMIC_ORDER_RELAXED), 6,
+            "chy_atomic_fetch_add returns the old value");
+    LONG_EQ(chy_atomic_load(&counter, ATOMIC_ORDER_SEQ_CST), 8,
+            "chy_atomic_fetch_add adds");
+
+    expected = 8;
+    OK(chy_atomic_cas(&counter, &expected, 10, ATOMIC_ORDER_ACQ_REL),
+       "chy_atomic_cas succeeds");
+    LONG_EQ(chy_atomic_load(&counter, ATOMIC_ORDER_ACQUIRE), 10,
+            "chy_atomic_cas stores the desired value");
+    expected = 8;
+    OK(!chy_atomic_cas(&counter, &expected, 12, ATOMIC_ORDER_RELEASE),
+       "chy_atomic_cas fails");
+    LONG_EQ(expected, 10, "chy_atomic_cas updates the expected value");
+
+    OK(chy_atomic_cas(&pointer, &expected_ptr, (void*)&value,
+                      ATOMIC_ORDER_SEQ_CST),
+       "chy_atomic_cas on pointers");
+    OK(chy_atomic_load(&pointer, ATOMIC_ORDER_RELAXED) == (void*)&value,
+       "chy_atomic_load on pointers");
+
+    chy_atomic_fence(ATOMIC_ORDER_SEQ_CST);
+    PASS("chy_atomic_fence");
+}
+
+#endif /* HAS_ATOMIC_LAYER */
+
+int main(int argc, char **argv) {
+    Test_start(11);
+#ifdef HAS_ATOMIC_LAYER
+    S_run_tests();
+#else
+    SKIP_REMAINING("No atomic operations");
+#endif
+    return !Test_finish();
+}
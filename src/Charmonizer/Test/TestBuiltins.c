@@ -0,0 +1,74 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+#define CHY_EMPLOY_BUILTINS
+
+#include "charmony.h"
+#include "Charmonizer/Test.h"
+
+static void
+S_run_tests(void) {
+    unsigned long word = 0x12345678UL;
+    int data[2] = { 0, 0 };
+    int hits = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (LIKELY(i < 3)) {
+            hits++;
+        }
+        if (UNLIKELY(i == 3)) {
+            hits += 10;
+        }
+    }
+    LONG_EQ(hits, 13, "LIKELY and UNLIKELY");
+
+    PREFETCH(&data[1]);
+    PASS("PREFETCH");
+    OK(ASSUME_ALIGNED(data, 1) == (void*)data, "ASSUME_ALIGNED");
+
+    LONG_EQ(POPCOUNT32(0xF0F0F0F0UL), 16, "POPCOUNT32");
+    LONG_EQ(CTZ32(0x100UL), 8, "CTZ32");
+    LONG_EQ(CLZ32(0x100UL), 23, "CLZ32");
+    LONG_EQ(CLZ32(1UL), 31, "CLZ32 of 1");
+    LONG_EQ(BSWAP16(0x1234), 0x3412, "BSWAP16");
+    LONG_EQ((long)(BSWAP32(word) & 0xFFFFFFFFUL), 0x78563412L, "BSWAP32");
+
+#ifdef POPCOUNT64
+    LONG_EQ(POPCOUNT64(word) + POPCOUNT64(0), 13, "POPCOUNT64");
+#else
+    SKIP("POPCOUNT64 not defined");
+#endif
+#ifdef CTZ64
+    LONG_EQ(CTZ64(word) + CTZ64(1), 3, "CTZ64");
+    LONG_EQ(CLZ64(word), 35, "CLZ64");
+#else
+    SKIP("CTZ64 not defined");
+    SKIP("CLZ64 not defined");
+#endif
+#ifdef BSWAP64
+    LONG_EQ((long)(BSWAP64(word) >> 32), 0x78563412L, "BSWAP64");
+#else
+    SKIP("BSWAP64 not defined");
+#endif
+}
+
+int main(int argc, char **argv) {
+    Test_start(13);
+    S_run_tests();
+    return !Test_finish();
+}
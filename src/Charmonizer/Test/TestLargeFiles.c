@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE
 #define CHAZ_USE_SHORT_NAMES
 #define CHY_EMPLOY_INTEGERLITERALS
 
@@ -33,6 +34,12 @@
 #ifdef CHAZ_HAS_IO_H
   #include <io.h>
 #endif
+#if defined(HAS_PREADV) || defined(HAS_PWRITEV) || defined(HAS_PREADV2)
+  #include <sys/uio.h>
+#endif
+#ifdef HAS_SENDFILE
+  #include <sys/sendfile.h>
+#endif
 
 #include <stdio.h>
 #include "Charmonizer/Test.h"
@@ -68,6 +75,184 @@ S_can_create_big_files(void);
   #define LARGEFILE_OPEN_FLAG 0
 #endif
 
+#define NUM_FAST_IO_TESTS 16
+
+static void
+S_run_fast_io_tests(void) {
+#if defined(CHAZ_HAS_FCNTL_H) && defined(CHY_HAS_UNISTD_H)
+    const char *path      = "_charm_fast_io_test";
+    const char *copy_path = "_charm_fast_io_copy";
+    char buf[8];
+    long check_val;
+    int fd, copy_fd;
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    copy_fd = open(copy_path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1 || copy_fd == -1 || write(fd, "0123456789", 10) != 10) {
+        int i;
+        for (i = 0; i < NUM_FAST_IO_TESTS; i++) {
+            SKIP("Failed to create test files");
+        }
+        if (fd != -1) { close(fd); }
+        if (copy_fd != -1) { close(copy_fd); }
+        remove(path);
+        remove(copy_path);
+        return;
+    }
+
+#ifdef HAS_FDATASYNC
+    LONG_EQ(fdatasync(fd), 0, "fdatasync");
+#else
+    SKIP("no fdatasync");
+#endif
+
+#ifdef HAS_POSIX_FALLOCATE
+    LONG_EQ(posix_fallocate(fd, 0, 8192), 0, "posix_fallocate");
+    LONG_EQ((long)lseek(fd, 0, SEEK_END), 8192,
+            "posix_fallocate extends file");
+#else
+    SKIP("no posix_fallocate");
+    SKIP("no posix_fallocate");
+#endif
+
+#ifdef HAS_PWRITEV
+    {
+        char first[2]  = { 'a', 'b' };
+        char second[2] = { 'c', 'd' };
+        struct iovec iov[2];
+        iov[0].iov_base = first;
+        iov[0].iov_len  = 2;
+        iov[1].iov_base = second;
+        iov[1].iov_len  = 2;
+        check_val = (long)pwritev(fd, iov, 2, 100);
+        LONG_EQ(check_val, 4, "pwritev");
+    }
+#else
+    SKIP("no pwritev");
+#endif
+
+#ifdef HAS_PREADV
+    {
+        struct iovec iov[2];
+        iov[0].iov_base = buf;
+        iov[0].iov_len  = 2;
+        iov[1].iov_base = buf + 2;
+        iov[1].iov_len  = 2;
+        check_val = (long)preadv(fd, iov, 2, 2);
+        LONG_EQ(check_val, 4, "preadv");
+        OK(memcmp(buf, "2345", 4) == 0, "preadv correct data");
+    }
+#else
+    SKIP("no preadv");
+    SKIP("no preadv");
+#endif
+
+#ifdef HAS_PREADV2
+    {
+        struct iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len  = 2;
+        check_val = (long)preadv2(fd, &iov, 1, 4, 0);
+        LONG_EQ(check_val, 2, "preadv2");
+    }
+#else
+    SKIP("no preadv2");
+#endif
+
+#ifdef HAS_COPY_FILE_RANGE
+    lseek(fd, 0, SEEK_SET);
+    check_val = (long)copy_file_range(fd, NULL, copy_fd, NULL, 4, 0);
+    if (check_val == -1
+        && (errno == ENOSYS || errno == EXDEV || errno == EOPNOTSUPP)
+       ) {
+        SKIP("copy_file_range not supported by kernel or filesystem");
+        SKIP("copy_file_range not supported by kernel or filesystem");
+    }
+    else {
+        LONG_EQ(check_val, 4, "copy_file_range");
+        lseek(copy_fd, 0, SEEK_SET);
+        check_val = (long)read(copy_fd, buf, 4);
+        OK(check_val == 4 && memcmp(buf, "0123", 4) == 0,
+           "copy_file_range correct data");
+    }
+#else
+    SKIP("no copy_file_range");
+    SKIP("no copy_file_range");
+#endif
+
+#ifdef HAS_SENDFILE
+    {
+        off_t offset = 4;
+        lseek(copy_fd, 0, SEEK_SET);
+        check_val = (long)sendfile(copy_fd, fd, &offset, 4);
+        LONG_EQ(check_val, 4, "sendfile");
+        lseek(copy_fd, 0, SEEK_SET);
+        check_val = (long)read(copy_fd, buf, 4);
+        OK(check_val == 4 && memcmp(buf, "4567", 4) == 0,
+           "sendfile correct data");
+    }
+#else
+    SKIP("no sendfile");
+    SKIP("no sendfile");
+#endif
+
+#ifdef HAS_SYNC_FILE_RANGE
+    LONG_EQ(sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE), 0,
+            "sync_file_range");
+#else
+    SKIP("no sync_file_range");
+#endif
+
+#ifdef HAS_O_DIRECT
+    OK(O_DIRECT_ALIGNMENT >= 512
+       && (O_DIRECT_ALIGNMENT & (O_DIRECT_ALIGNMENT - 1)) == 0,
+       "O_DIRECT_ALIGNMENT is a power of two");
+    {
+        int direct_fd = open(path, O_RDONLY | O_DIRECT);
+        if (direct_fd != -1) {
+            PASS("open with O_DIRECT");
+            close(direct_fd);
+        }
+        else if (errno == EINVAL) {
+            SKIP("Filesystem doesn't support O_DIRECT");
+        }
+        else {
+            FAIL("open with O_DIRECT");
+        }
+    }
+#else
+    SKIP("no O_DIRECT");
+    SKIP("no O_DIRECT");
+#endif
+
+#ifdef HAS_O_NOATIME
+    {
+        int noatime_fd = open(path, O_RDONLY | O_NOATIME);
+        OK(noatime_fd != -1, "open with O_NOATIME");
+        if (noatime_fd != -1) { close(noatime_fd); }
+    }
+#else
+    SKIP("no O_NOATIME");
+#endif
+
+#ifdef HAS_F_NOCACHE
+    LONG_EQ(fcntl(fd, F_NOCACHE, 1), 0, "F_NOCACHE");
+#else
+    SKIP("no F_NOCACHE");
+#endif
+
+    close(fd);
+    close(copy_fd);
+    remove(path);
+    remove(copy_path);
+#else
+    int i;
+    for (i = 0; i < NUM_FAST_IO_TESTS; i++) {
+        SKIP("Need fcntl.h and unistd.h");
+    }
+#endif
+}
+
 static void
 S_run_tests(void) {
     FILE *fh;
@@ -274,7 +459,8 @@ S_can_create_big_files(void) {
 #endif /* STAT_TESTS_ENABLED */
 
 int main(int argc, char **argv) {
-    Test_start(20);
+    Test_start(20 + NUM_FAST_IO_TESTS);
+    S_run_fast_io_tests();
     S_run_tests();
     return !Test_finish();
 }
@@ -0,0 +1,285 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+
+#include "charmony.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAS_SYS_STAT_H
+  #include <sys/stat.h>
+#endif
+#ifdef HAS_UNISTD_H
+  #include <unistd.h>
+#endif
+#ifdef HAS_DIRECT_H
+  #include <direct.h>
+#endif
+#include "Charmonizer/Probe.h"
+#include "Charmonizer/Core/CLI.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/Make.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Util.h"
+#include "Charmonizer/Test.h"
+
+#define WORK_DIR "_charm_make_test"
+#define NUM_BENCH_SOURCES 100000
+
+/* Generating a makefile used to take time quadratic in the number of
+ * sources, about 45 seconds for 100,000 sources. Linear generation takes
+ * well under a second, so this limit only trips on a regression.
+ */
+#define MAX_BENCH_SECONDS 10.0
+
+static chaz_CLI *cli = NULL;
+
+/* Initialize the Make module as if charmonize was run with the compiler
+ * from the CC environment variable and the option `option` which may be
+ * NULL.
+ */
+static void
+S_init_make(const char *option) {
+    const char *cc = getenv("CC");
+    const char *argv[3];
+    char *cc_arg;
+    int argc = 0;
+
+    if (cc == NULL || cc[0] == '\0') {
+#ifdef _MSC_VER
+        cc = "cl";
+#else
+        cc = "cc";
+#endif
+    }
+    cc_arg = chaz_Util_join("", "--cc=", cc, NULL);
+    argv[argc++] = "TestMake";
+    argv[argc++] = cc_arg;
+    if (option) { argv[argc++] = option; }
+
+    if (cli) {
+        chaz_Make_clean_up();
+        chaz_CLI_destroy(cli);
+    }
+    cli = chaz_CLI_new("TestMake", NULL);
+    if (!chaz_Probe_parse_cli_args(argc, argv, cli)) {
+        chaz_Util_die("Failed to parse arguments");
+    }
+    if (!chaz_CC_get_cc()) {
+        chaz_OS_init();
+        chaz_CC_init(chaz_CLI_strval(cli, "cc"),
+                     chaz_CLI_strval(cli, "cflags"));
+    }
+    chaz_Make_init(cli);
+    free(cc_arg);
+}
+
+static void
+S_test_generation_time(void) {
+    chaz_MakeFile   *makefile = chaz_MakeFile_new();
+    chaz_MakeRule   *clean    = chaz_MakeFile_clean_rule(makefile);
+    chaz_MakeBinary *lib;
+    char    *content;
+    size_t   len;
+    char     path[40];
+    clock_t  start;
+    double   seconds;
+    long     i;
+
+    start = clock();
+    lib = chaz_MakeFile_add_shared_lib(makefile, NULL, "bench", "1.0.0",
+                                       "1", 0);
+    for (i = 0; i < NUM_BENCH_SOURCES; i++) {
+        sprintf(path, "src%sfile%ld.c", chaz_OS_dir_sep(), i);
+        chaz_MakeBinary_add_src_file(lib, NULL, path);
+        chaz_MakeRule_add_rm_command(clean, path);
+    }
+    chaz_MakeFile_write(makefile);
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    chaz_MakeFile_destroy(makefile);
+
+    printf("# Generated a makefile with %d sources in %.2f seconds\n",
+           NUM_BENCH_SOURCES, seconds);
+    OK(seconds < MAX_BENCH_SECONDS, "makefile generation is fast");
+
+    content = chaz_Util_slurp_file("Makefile", &len);
+    sprintf(path, "file%ld.c", (long)NUM_BENCH_SOURCES - 1);
+    OK(strstr(content, path) != NULL, "makefile contains all sources");
+    free(content);
+    chaz_OS_remove("Makefile");
+}
+
+static void
+S_test_ninja(void) {
+    chaz_MakeFile   *makefile;
+    chaz_MakeBinary *lib;
+    char   *content;
+    char   *rule;
+    size_t  len;
+
+    S_init_make("--enable-ninja");
+    makefile = chaz_MakeFile_new();
+    lib = chaz_MakeFile_add_shared_lib(makefile, NULL, "ninja", "1.0.0",
+                                       "1", 0);
+    chaz_MakeBinary_add_src_file(lib, NULL, "foo.c");
+    chaz_MakeBinary_add_src_file(lib, NULL, "bar.c");
+    chaz_MakeFile_install(makefile, "foo.h", "$(DATADIR)", NULL);
+    chaz_MakeFile_write(makefile);
+    chaz_MakeFile_destroy(makefile);
+
+    content = chaz_Util_slurp_file("build.ninja", &len);
+    if (chaz_CC_is_msvc()) {
+        OK(strstr(content, "  deps = msvc\n") != NULL, "deps = msvc");
+    }
+    else if (strstr(content, "DEPFLAGS") != NULL) {
+        OK(strstr(content, "  deps = gcc\n") != NULL, "deps = gcc");
+    }
+    else {
+        SKIP("Compiler doesn't write dependency files");
+    }
+    OK(strstr(content, "  pool = link_pool\n") != NULL,
+       "link jobs use link_pool");
+    OK(strstr(content, "build clean: phony _charm_clean\n") != NULL,
+       "clean is a phony alias");
+    OK(strstr(content, "build install: phony _charm_install\n") != NULL,
+       "install is a phony alias");
+    rule = strstr(content, "build _charm_distclean: run");
+    OK(rule != NULL && strstr(rule, "build.ninja") == NULL,
+       "distclean in build.ninja keeps build.ninja");
+    free(content);
+
+    content = chaz_Util_slurp_file("Makefile", &len);
+    rule = strstr(content, "distclean :");
+    OK(rule != NULL && strstr(rule, "build.ninja") != NULL,
+       "distclean in Makefile removes build.ninja");
+    free(content);
+
+    chaz_OS_remove("build.ninja");
+    chaz_OS_remove("Makefile");
+}
+
+/* Count the occurrences of `needle` in `haystack`.
+ */
+static long
+S_count(const char *haystack, const char *needle) {
+    long count = 0;
+
+    while ((haystack = strstr(haystack, needle)) != NULL) {
+        count++;
+        haystack++;
+    }
+
+    return count;
+}
+
+static void
+S_test_build_profile(void) {
+    chaz_MakeFile   *makefile;
+    chaz_MakeBinary *exe;
+    char   *content;
+    size_t  len;
+
+    S_init_make("--enable-build-profiling");
+    makefile = chaz_MakeFile_new();
+    exe = chaz_MakeFile_add_exe(makefile, NULL, "profiled", 0);
+    chaz_MakeBinary_add_src_file(exe, NULL, "foo.c");
+    chaz_MakeFile_enable_pgo(makefile, "profiled", "./profiled");
+
+    /* Generated rules must only be added once. */
+    chaz_MakeFile_write(makefile);
+    chaz_MakeFile_write(makefile);
+    chaz_MakeFile_destroy(makefile);
+
+    content = chaz_Util_slurp_file("Makefile", &len);
+    if (strstr(content, "pgo-instrument") != NULL) {
+        LONG_EQ(1, S_count(content, "\npgo-instrument :"),
+                "PGO rules are added once");
+        OK(strstr(content, "$(PROFILED_EXE_OBJS) $(PGO_STAMP)\n") != NULL,
+           "binaries are relinked when switching PGO modes");
+    }
+    else {
+        SKIP("Compiler doesn't support PGO");
+        SKIP("Compiler doesn't support PGO");
+    }
+    if (strstr(content, "\nbuild-profile :") != NULL) {
+        LONG_EQ(1, S_count(content, "\nbuild-profile :"),
+                "build-profile rule is added once");
+        OK(strstr(content, "$(PROFILED_EXE_OBJS:") != NULL,
+           "build-profile reads the traces of all binaries");
+        OK(chaz_Util_can_open_file("build-profile.awk"),
+           "build-profile.awk written");
+    }
+    else {
+        SKIP("Compiler doesn't support -ftime-trace");
+        SKIP("Compiler doesn't support -ftime-trace");
+        SKIP("Compiler doesn't support -ftime-trace");
+    }
+    free(content);
+
+    chaz_OS_remove("build-profile.awk");
+    chaz_OS_remove("Makefile");
+}
+
+static void
+S_test_grouped_targets(void) {
+    chaz_MakeFile *makefile;
+    chaz_MakeRule *rule;
+    char   *content;
+    size_t  len;
+
+    S_init_make(NULL);
+    makefile = chaz_MakeFile_new();
+    rule = chaz_MakeFile_add_rule(makefile, "parse.c parse.h", "parse.y");
+    chaz_MakeRule_group_targets(rule);
+    chaz_MakeRule_add_command(rule, "lemon parse.y");
+    chaz_MakeFile_write(makefile);
+    chaz_MakeFile_destroy(makefile);
+
+    content = chaz_Util_slurp_file("Makefile", &len);
+    OK(strstr(content, "\nparse.c parse.h &: parse.y\n") != NULL
+       || strstr(content, "\nparse.c parse.h : parse.c.stamp ;\n") != NULL,
+       "targets passed as a single string are grouped");
+    free(content);
+
+    chaz_OS_remove("Makefile");
+}
+
+int main(int argc, char **argv) {
+    chaz_Util_verbosity = 0;
+    Test_start(14);
+
+    if (makedir(WORK_DIR, 0777) != 0 || chdir(WORK_DIR) != 0) {
+        SKIP_REMAINING("Can't create work directory");
+        return !Test_finish();
+    }
+
+    S_init_make(NULL);
+    S_test_generation_time();
+    S_test_ninja();
+    S_test_build_profile();
+    S_test_grouped_targets();
+
+    chaz_Make_clean_up();
+    chaz_CLI_destroy(cli);
+    chaz_CC_clean_up();
+    if (chdir("..") == 0) {
+        rmdir(WORK_DIR);
+    }
+
+    return !Test_finish();
+}
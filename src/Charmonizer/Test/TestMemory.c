@@ -0,0 +1,48 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+#define CHY_EMPLOY_ALIGNED_ALLOC
+
+#include "charmony.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAS_MALLOC_H
+  #include <malloc.h>
+#endif
+#include "Charmonizer/Test.h"
+
+static void
+S_run_tests(void) {
+    size_t alignment;
+
+    for (alignment = 8; alignment <= 4096; alignment *= 8) {
+        char *ptr = (char*)chy_aligned_alloc(alignment, 100);
+        OK(ptr != NULL, "chy_aligned_alloc succeeds");
+        LONG_EQ((long)((size_t)ptr % alignment), 0,
+                "chy_aligned_alloc returns aligned memory");
+        memset(ptr, 0, 100);
+        chy_aligned_free(ptr);
+    }
+    chy_aligned_free(NULL);
+    PASS("chy_aligned_free accepts NULL");
+}
+
+int main(int argc, char **argv) {
+    Test_start(9);
+    S_run_tests();
+    return !Test_finish();
+}